@@ -2,6 +2,15 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <numeric>
+#include <climits>
+#include <cmath>
+#include <span>
+#include <future>
+#include <thread>
+#include <stdexcept>
+#include <iterator>
+#include <cstdint>
 
 class BigInteger {
 private:
@@ -19,9 +28,23 @@ private:
         }
     }
 
+    //the quotient is guessed from the leading limbs and then checked by a short binary search
     int find_div(const BigInteger& other) const {
-        int left = 0;
-        int right = mod;
+        if ((*this) < other) {
+            return 0;
+        }
+        size_t used = std::min<size_t>(digits.size(), 3);
+        size_t other_used = std::min<size_t>(other.digits.size(), 3);
+        double shift = static_cast<double>(digits.size() - used) - static_cast<double>(other.digits.size() - other_used);
+        double estimate = leadingDigits(used) / other.leadingDigits(other_used) * std::pow(static_cast<double>(mod), shift);
+        int left = static_cast<int>(std::max(estimate - 2, 0.0));
+        int right = static_cast<int>(std::min(estimate + 3, static_cast<double>(mod)));
+        if (other * left > (*this)) {
+            left = 0;
+        }
+        if (right < mod && other * right <= (*this)) {
+            right = mod;
+        }
         while (right - left > 1) {
             int mid = (left + right) / 2;
             BigInteger result = other;
@@ -247,8 +270,13 @@ public:
             delete_zero();
             return *this;
         }
-        digits[0] = (mod - digits[0]) % mod;
-        for (size_t i = 1; i < digits.size(); ++i) {
+        //the limbs hold mod^size - |result|: negate it, the zero limbs at the bottom borrow nothing
+        size_t first_nonzero = 0;
+        while (digits[first_nonzero] == 0) {
+            ++first_nonzero;
+        }
+        digits[first_nonzero] = mod - digits[first_nonzero];
+        for (size_t i = first_nonzero + 1; i < digits.size(); ++i) {
             digits[i] = mod - 1 - digits[i];
         }
         ChangeSign();
@@ -287,12 +315,14 @@ public:
 
     BigInteger& operator*=(const BigInteger& other) {
         BigInteger copy = *this;
+        //x *= x must not read other after *this is cleared
+        const BigInteger& multiplier = this == &other ? copy : other;
         *this = 0;
-        for (size_t i = other.digits.size(); i > 0; --i) {
+        for (size_t i = multiplier.digits.size(); i > 0; --i) {
             *this *= mod;
-            *this += copy * other.digits[i - 1];
+            *this += copy * multiplier.digits[i - 1];
         }
-        if (other.isNegative) {
+        if (multiplier.isNegative) {
             ChangeSign();
         }
         delete_zero();
@@ -330,26 +360,36 @@ public:
 
     BigInteger& operator%=(const BigInteger& other) {
         BigInteger div = (*this);
-        div /= other;
-        BigInteger result = other;
-        result *= div;
-        *this -= result;
+        div.divmod(other, *this);
+        return *this;
+    }
+
+    BigInteger& divmod(const BigInteger& other, BigInteger& remainder);
+
+    BigInteger& shiftLimbs(size_t count) {
+        if (digits.size() > 0) {
+            digits.insert(digits.begin(), count, 0);
+        }
         return *this;
     }
 
+    BigInteger& multiplyByPowerOfTen(size_t power) {
+        int small_power = 1;
+        for (size_t i = 0; i < power % max_length; ++i) {
+            small_power *= 10;
+        }
+        *this *= small_power;
+        return shiftLimbs(power / max_length);
+    }
+
     explicit operator bool() const {
         return (digits.size() != 0);
     }
 
     explicit operator long long() const {
-        if (digits.size() == 0) {
-            return 0;
-        }
         long long ans = 0;
-        long long kmod = 1;
-        for (size_t i = 0; i < digits.size(); ++i) {
-            ans += static_cast<long long>(digits[i]) * kmod;
-            kmod *= mod;
+        for (size_t i = digits.size(); i > 0; --i) {
+            ans = ans * mod + digits[i - 1];
         }
         if (isNegative) {
             return -ans;
@@ -357,7 +397,42 @@ public:
         return ans;
     }
 
-    bool IsNegative() {
+    size_t length() const {
+        return digits.size();
+    }
+
+    //the value modulo a word-size modulus, in [0, modulus)
+    uint64_t residue(uint64_t modulus) const {
+        unsigned __int128 ans = 0;
+        for (size_t i = digits.size(); i > 0; --i) {
+            ans = (ans * mod + digits[i - 1]) % modulus;
+        }
+        uint64_t value = static_cast<uint64_t>(ans);
+        return (isNegative && value != 0) ? modulus - value : value;
+    }
+
+    double leadingDigits(size_t count) const {
+        double ans = 0;
+        for (size_t i = digits.size(); i > 0 && i + count > digits.size(); --i) {
+            ans = ans * mod + digits[i - 1];
+        }
+        return ans;
+    }
+
+    bool fitsLongLong() const {
+        static const int max_digits[3] = {854775807, 223372036, 9};
+        if (digits.size() != 3) {
+            return digits.size() < 3;
+        }
+        for (size_t i = 3; i > 0; --i) {
+            if (digits[i - 1] != max_digits[i - 1]) {
+                return digits[i - 1] < max_digits[i - 1];
+            }
+        }
+        return true;
+    }
+
+    bool IsNegative() const {
         return isNegative;
     }
 
@@ -414,12 +489,17 @@ std::istream& operator>>(std::istream& in, BigInteger& num) {
     return in;
 }
 
-BigInteger& BigInteger::operator/=(const BigInteger& other) {
+BigInteger& BigInteger::divmod(const BigInteger& other, BigInteger& remainder) {
+    bool remainder_negative = isNegative;
     if (other.isNegative) {
         ChangeSign();
     }
     BigInteger initial_part = 0;
     int index = digits.size() - 1;
+    //the leading limbs below the divisor's length give zero quotient digits, so they are taken at once
+    size_t skipped = other.digits.empty() ? 0 : std::min(digits.size(), other.digits.size() - 1);
+    initial_part.digits.assign(digits.end() - skipped, digits.end());
+    index -= skipped;
     std::vector<int>result_digits;
     BigInteger AbsOther = other;
     AbsOther.isNegative = false;
@@ -434,9 +514,18 @@ BigInteger& BigInteger::operator/=(const BigInteger& other) {
     std::reverse(result_digits.begin(), result_digits.end());
     digits = result_digits;
     delete_zero();
+    remainder.swap(initial_part);
+    if (remainder_negative && remainder.digits.size() > 0) {
+        remainder.ChangeSign();
+    }
     return *this;
 }
 
+BigInteger& BigInteger::operator/=(const BigInteger& other) {
+    BigInteger remainder;
+    return divmod(other, remainder);
+}
+
 BigInteger gcd(BigInteger first, BigInteger second) {
     if (first.IsNegative()) {
         first.ChangeSign();
@@ -453,8 +542,39 @@ BigInteger gcd(BigInteger first, BigInteger second) {
     return gcd(second, first % second);
 }
 
+//one step of the Euclidean algorithm: quotient = floor(first / second), (first, second) = (second, first mod second)
+void euclidStep(long long& first, long long& second, long long& quotient) {
+    quotient = first / second;
+    long long remainder = first % second;
+    if (remainder < 0) {
+        --quotient;
+        remainder += second;
+    }
+    first = second;
+    second = remainder;
+}
+
+void euclidStep(BigInteger& first, BigInteger& second, BigInteger& quotient) {
+    BigInteger remainder;
+    quotient = first;
+    quotient.divmod(second, remainder);
+    if (remainder < 0) {
+        --quotient;
+        remainder += second;
+    }
+    first.swap(second);
+    second.swap(remainder);
+}
+
+class ConvergentIterator;
+
+class ConvergentRange;
+
 class Rational {
 private:
+    long long smallNumerator = 0;
+    long long smallDenominator = 1;
+    bool isSmall = true;
     BigInteger numerator;
     BigInteger denominator;
 
@@ -467,60 +587,424 @@ private:
             numerator.ChangeSign();
         }
     }
+
+    void promote() {
+        if (!isSmall) {
+            return;
+        }
+        numerator = smallNumerator;
+        denominator = smallDenominator;
+        isSmall = false;
+    }
+
+    void shrink() {
+        if (isSmall || !numerator.fitsLongLong() || !denominator.fitsLongLong()) {
+            return;
+        }
+        smallNumerator = static_cast<long long>(numerator);
+        smallDenominator = static_cast<long long>(denominator);
+        numerator = BigInteger();
+        denominator = BigInteger();
+        isSmall = true;
+    }
+
+    //small fractions are kept reduced with a positive denominator and a numerator other than LLONG_MIN,
+    //so the helpers below may negate freely; false means an overflow and the caller switches to BigInteger
+    bool addSmall(long long a, long long b, long long c, long long d) {
+        long long g = std::gcd(b, d);
+        long long left = 0;
+        long long right = 0;
+        long long num = 0;
+        long long den = 0;
+        if (__builtin_mul_overflow(a, d / g, &left) || __builtin_mul_overflow(c, b / g, &right) ||
+            __builtin_add_overflow(left, right, &num) || __builtin_mul_overflow(b / g, d, &den) || num == LLONG_MIN) {
+            return false;
+        }
+        g = std::gcd(num, g);
+        smallNumerator = num / g;
+        smallDenominator = den / g;
+        return true;
+    }
+
+    bool mulSmall(long long a, long long b, long long c, long long d) {
+        if (a == 0 || c == 0) {
+            smallNumerator = 0;
+            smallDenominator = 1;
+            return true;
+        }
+        long long g1 = std::gcd(a, d);
+        long long g2 = std::gcd(c, b);
+        long long num = 0;
+        long long den = 0;
+        if (__builtin_mul_overflow(a / g1, c / g2, &num) || __builtin_mul_overflow(b / g2, d / g1, &den) ||
+            num == LLONG_MIN || den == LLONG_MIN) {
+            return false;
+        }
+        if (den < 0) {
+            num = -num;
+            den = -den;
+        }
+        smallNumerator = num;
+        smallDenominator = den;
+        return true;
+    }
+
+    static long long limbCount(long long value) {
+        long long count = 0;
+        for (; value != 0; value /= 1000000000) {
+            ++count;
+        }
+        return count;
+    }
+
+    //the absolute value lies strictly between 1e9^(scale() - 1) and 1e9^(scale() + 1)
+    long long scale() const {
+        if (isSmall) {
+            return limbCount(smallNumerator) - limbCount(smallDenominator);
+        }
+        return static_cast<long long>(numerator.length()) - static_cast<long long>(denominator.length());
+    }
+
+    //the absolute value is approximately mantissa(exponent) * 1e9^exponent
+    double mantissa(long long& exponent) const {
+        if (isSmall) {
+            exponent = 0;
+            return std::abs(static_cast<double>(smallNumerator)) / static_cast<double>(smallDenominator);
+        }
+        size_t numerator_used = std::min<size_t>(numerator.length(), 3);
+        size_t denominator_used = std::min<size_t>(denominator.length(), 3);
+        exponent = static_cast<long long>(numerator.length() - numerator_used) - static_cast<long long>(denominator.length() - denominator_used);
+        return numerator.leadingDigits(numerator_used) / denominator.leadingDigits(denominator_used);
+    }
+
+    //-1 or 1 when the magnitudes are surely ordered, 0 when only exact arithmetic can tell
+    int compareMagnitudes(const Rational& other) const {
+        long long scale_difference = scale() - other.scale();
+        if (scale_difference >= 2) {
+            return 1;
+        }
+        if (scale_difference <= -2) {
+            return -1;
+        }
+        long long first_exponent = 0;
+        long long second_exponent = 0;
+        double first_mantissa = mantissa(first_exponent);
+        double second_mantissa = other.mantissa(second_exponent);
+        double ratio = first_mantissa / second_mantissa * std::pow(1e9, static_cast<double>(first_exponent - second_exponent));
+        if (ratio > 1 + 1e-12) {
+            return 1;
+        }
+        if (ratio < 1 - 1e-12) {
+            return -1;
+        }
+        return 0;
+    }
+
+    Rational bigCopy() const {
+        Rational copy = *this;
+        copy.promote();
+        return copy;
+    }
+
+    //with g = gcd(d1, d2) the sum is (n1 (d2 / g) + n2 (d1 / g)) / (d1 / g * d2), where only factors of g
+    //can cancel
+    void addBig(const Rational& other) {
+        BigInteger gcd_denominator = gcd(denominator, other.denominator);
+        if (gcd_denominator == 1) {
+            numerator = numerator * other.denominator + other.numerator * denominator;
+            denominator *= other.denominator;
+            return;
+        }
+        BigInteger cofactor = denominator / gcd_denominator;
+        BigInteger sum = numerator * (other.denominator / gcd_denominator) + other.numerator * cofactor;
+        if (!sum) {
+            numerator = BigInteger();
+            denominator = 1;
+            return;
+        }
+        BigInteger common = gcd(sum, gcd_denominator);
+        numerator = sum / common;
+        denominator = cofactor * (other.denominator / common);
+    }
+
+    //the cross gcds cancel before the products are formed, so the result is reduced and the factors stay small
+    void mulBig(const BigInteger& other_numerator, const BigInteger& other_denominator) {
+        BigInteger gcd1 = gcd(numerator, other_denominator);
+        BigInteger gcd2 = gcd(other_numerator, denominator);
+        BigInteger product = (numerator / gcd1) * (other_numerator / gcd2);
+        denominator = (denominator / gcd2) * (other_denominator / gcd1);
+        numerator = std::move(product);
+        if (denominator.IsNegative()) {
+            denominator.ChangeSign();
+            numerator.ChangeSign();
+        }
+    }
+
+    void addReducingOnce(const Rational& other) {
+        if (isSmall && other.isSmall && addSmall(smallNumerator, smallDenominator, other.smallNumerator, other.smallDenominator)) {
+            return;
+        }
+        promote();
+        if (other.isSmall) {
+            addReducingOnce(other.bigCopy());
+            return;
+        }
+        numerator = numerator * other.denominator + other.numerator * denominator;
+        denominator *= other.denominator;
+        norm();
+        shrink();
+    }
+
+    //sums term(left), ..., term(right - 1) as a balanced tree, the halves of big ranges go to separate threads
+    template <typename Term>
+    static Rational sumTree(const Term& term, size_t left, size_t right, size_t threads) {
+        static const size_t parallel_threshold = 256;
+        if (right - left == 1) {
+            return term(left);
+        }
+        size_t middle = left + (right - left) / 2;
+        Rational first;
+        Rational second;
+        if (threads > 1 && right - left >= parallel_threshold) {
+            std::future<Rational> first_half = std::async(std::launch::async, [&] {
+                return sumTree(term, left, middle, threads / 2);
+            });
+            second = sumTree(term, middle, right, threads - threads / 2);
+            first = first_half.get();
+        }
+        else {
+            first = sumTree(term, left, middle, 1);
+            second = sumTree(term, middle, right, 1);
+        }
+        first.addReducingOnce(second);
+        return first;
+    }
+
+    static size_t threadsFor(bool parallel) {
+        return parallel ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : 1;
+    }
+
+    static Rational fromReduced(long long num, long long den) {
+        Rational ans;
+        ans.smallNumerator = num;
+        ans.smallDenominator = den;
+        return ans;
+    }
+
+    static Rational fromReduced(const BigInteger& num, const BigInteger& den) {
+        Rational ans;
+        ans.isSmall = false;
+        ans.numerator = num;
+        ans.denominator = den;
+        ans.shrink();
+        return ans;
+    }
+
+    //walks the convergents p/q of num/den while q <= max_denominator and then picks the closer of
+    //the last convergent and the largest semiconvergent that still fits
+    template <typename Integer>
+    Rational closestWithDenominator(Integer num, Integer den, const Integer& max_denominator) const {
+        Integer previous_numerator = 0;
+        Integer previous_denominator = 1;
+        Integer current_numerator = 1;
+        Integer current_denominator = 0;
+        Integer quotient = 0;
+        while (true) {
+            euclidStep(num, den, quotient);
+            Integer next_denominator = previous_denominator + quotient * current_denominator;
+            if (next_denominator > max_denominator) {
+                break;
+            }
+            Integer next_numerator = previous_numerator + quotient * current_numerator;
+            std::swap(previous_numerator, current_numerator);
+            std::swap(previous_denominator, current_denominator);
+            std::swap(current_numerator, next_numerator);
+            std::swap(current_denominator, next_denominator);
+        }
+        Integer k = (max_denominator - previous_denominator) / current_denominator;
+        Rational semiconvergent = fromReduced(previous_numerator + k * current_numerator, previous_denominator + k * current_denominator);
+        Rational convergent = fromReduced(current_numerator, current_denominator);
+        Rational semiconvergent_error = semiconvergent;
+        Rational convergent_error = convergent;
+        semiconvergent_error -= *this;
+        convergent_error -= *this;
+        if (semiconvergent_error.sign() < 0) {
+            semiconvergent_error = -semiconvergent_error;
+        }
+        if (convergent_error.sign() < 0) {
+            convergent_error = -convergent_error;
+        }
+        return semiconvergent_error < convergent_error ? semiconvergent : convergent;
+    }
+
+    friend class ConvergentIterator;
+
+    friend Rational sum(std::span<const Rational> values, bool parallel);
+
+    friend Rational dot(std::span<const Rational> first, std::span<const Rational> second, bool parallel);
 public:
-    Rational() : numerator(0), denominator(1) {}
+    Rational() = default;
 
     Rational(const Rational& ration) = default;
 
-    Rational(int num) : numerator(num), denominator(1) {}
+    Rational(Rational&& ration) = default;
 
-    Rational(const BigInteger& num) : numerator(num), denominator(1) {}
+    Rational(int num) : smallNumerator(num) {}
 
-    Rational(const BigInteger& numerator, const BigInteger& denominator) : numerator(numerator), denominator(denominator) {
-        norm();
+    Rational(const BigInteger& num) : isSmall(false), numerator(num), denominator(1) {
+        shrink();
     }
 
-    Rational& operator=(const Rational& other) {
-        numerator = other.numerator;
-        denominator = other.denominator;
-        return *this;
+    Rational(const BigInteger& numerator, const BigInteger& denominator) : isSmall(false), numerator(numerator), denominator(denominator) {
+        norm();
+        shrink();
     }
 
+    Rational& operator=(const Rational& other) = default;
+
+    Rational& operator=(Rational&& other) = default;
+
     Rational operator-() const {
         Rational copy = *this;
-        copy.numerator = -copy.numerator;
+        if (isSmall) {
+            copy.smallNumerator = -copy.smallNumerator;
+        }
+        else {
+            copy.numerator = -copy.numerator;
+        }
         return copy;
     }
 
     Rational& operator+=(const Rational& other) {
-        numerator = numerator * other.denominator + other.numerator * denominator;
-        denominator *= other.denominator;
-        norm();
+        if (isSmall && other.isSmall && addSmall(smallNumerator, smallDenominator, other.smallNumerator, other.smallDenominator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            addBig(other.bigCopy());
+        }
+        else {
+            addBig(other);
+        }
+        shrink();
         return *this;
     }
 
     Rational& operator-=(const Rational& other) {
-        numerator = numerator * other.denominator - other.numerator * denominator;
-        denominator *= other.denominator;
-        norm();
+        if (isSmall && other.isSmall && addSmall(smallNumerator, smallDenominator, -other.smallNumerator, other.smallDenominator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            addBig(-other.bigCopy());
+        }
+        else {
+            addBig(-other);
+        }
+        shrink();
         return *this;
     }
 
     Rational& operator*=(const Rational& other) {
-        numerator *= other.numerator;
-        denominator *= other.denominator;
-        norm();
+        if (isSmall && other.isSmall && mulSmall(smallNumerator, smallDenominator, other.smallNumerator, other.smallDenominator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            mulBig(other.smallNumerator, other.smallDenominator);
+        }
+        else {
+            mulBig(other.numerator, other.denominator);
+        }
+        shrink();
         return *this;
     }
 
     Rational& operator/=(const Rational& other) {
-        numerator *= other.denominator;
-        denominator *= other.numerator;
-        norm();
+        if (isSmall && other.isSmall && mulSmall(smallNumerator, smallDenominator, other.smallDenominator, other.smallNumerator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            mulBig(other.smallDenominator, other.smallNumerator);
+        }
+        else {
+            mulBig(other.denominator, other.numerator);
+        }
+        shrink();
         return *this;
     }
 
+    //*this += first * second, or -= with subtract; no temporary fraction is made while everything fits in long long
+    Rational& addProduct(const Rational& first, const Rational& second, bool subtract = false) {
+        if (isSmall && first.isSmall && second.isSmall) {
+            long long num = smallNumerator;
+            long long den = smallDenominator;
+            if (mulSmall(first.smallNumerator, first.smallDenominator, second.smallNumerator, second.smallDenominator) &&
+                addSmall(num, den, subtract ? -smallNumerator : smallNumerator, smallDenominator)) {
+                return *this;
+            }
+            smallNumerator = num;
+            smallDenominator = den;
+        }
+        if (first.isZero() || second.isZero()) {
+            return *this;
+        }
+        Rational product = first;
+        product *= second;
+        if (subtract) {
+            product.negate();
+        }
+        return *this += product;
+    }
+
+    Rational& subtractProduct(const Rational& first, const Rational& second) {
+        return addProduct(first, second, true);
+    }
+
+    void negate() {
+        if (isSmall) {
+            smallNumerator = -smallNumerator;
+        }
+        else {
+            numerator.ChangeSign();
+        }
+    }
+
+    BigInteger getNumerator() const {
+        return isSmall ? BigInteger(smallNumerator) : numerator;
+    }
+
+    BigInteger getDenominator() const {
+        return isSmall ? BigInteger(smallDenominator) : denominator;
+    }
+
+    Rational limitDenominator(const BigInteger& max_denominator) const {
+        if (max_denominator < 1) {
+            throw std::invalid_argument("the maximal denominator must be positive");
+        }
+        if (isSmall) {
+            if (!max_denominator.fitsLongLong() || smallDenominator <= static_cast<long long>(max_denominator)) {
+                return *this;
+            }
+            return closestWithDenominator<long long>(smallNumerator, smallDenominator, static_cast<long long>(max_denominator));
+        }
+        if (denominator <= max_denominator) {
+            return *this;
+        }
+        return closestWithDenominator<BigInteger>(numerator, denominator, max_denominator);
+    }
+
+    ConvergentRange convergents() const;
+
+    bool isZero() const {
+        return isSmall && smallNumerator == 0;
+    }
+
     int sign() const {
+        if (isSmall) {
+            return (smallNumerator > 0) - (smallNumerator < 0);
+        }
         if (numerator > 0) {
             return 1;
         }
@@ -531,6 +1015,12 @@ public:
     }
 
     std::string toString() const {
+        if (isSmall) {
+            if (smallDenominator != 1) {
+                return std::to_string(smallNumerator) + '/' + std::to_string(smallDenominator);
+            }
+            return std::to_string(smallNumerator);
+        }
         if (denominator != 1) {
             return numerator.toString() + '/' + denominator.toString();
         }
@@ -539,32 +1029,63 @@ public:
         }
     }
 
-    std::string asDecimal(size_t presision = 0) const {
+    //the fraction is produced by long division in chunks of at least chunk_limbs limbs, each of them
+    //needs one shift by a power of ten and one divmod by the denominator
+    template <typename Consumer>
+    void decimalChunks(size_t presision, const Consumer& consume) const {
+        static const size_t chunk_limbs = 64;
+        if (isSmall) {
+            bigCopy().decimalChunks(presision, consume);
+            return;
+        }
         if (presision == 0) {
-            return (numerator / denominator).toString();
+            consume((numerator / denominator).toString());
+            return;
         }
-        std::string ans;
-        Rational copy = *this;
-        if (copy.numerator < 0) {
-            ans += '-';
-            copy = -copy;
+        if (numerator < 0) {
+            consume("-");
         }
-        BigInteger num = copy.numerator % copy.denominator;
-        for (size_t i = 0; i < presision; ++i) {
-            num *= 10;
+        BigInteger remainder;
+        BigInteger integer_part = numerator;
+        integer_part.divmod(denominator, remainder);
+        if (remainder < 0) {
+            remainder.ChangeSign();
         }
-        std::string ans_first = (copy.numerator / copy.denominator).toString() + '.';
-        std::string ans_second = (num / copy.denominator).toString();
-        for (size_t i = 0; i < presision - ans_second.size(); ++i) {
-            ans_first += '0';
+        if (integer_part < 0) {
+            integer_part.ChangeSign();
         }
-        ans += ans_first + ans_second;
+        consume(integer_part.toString() + '.');
+        size_t chunk = std::max(chunk_limbs, denominator.length()) * 9;
+        for (size_t written = 0; written < presision; written += chunk) {
+            size_t count = std::min(chunk, presision - written);
+            BigInteger digits = remainder.multiplyByPowerOfTen(count);
+            digits.divmod(denominator, remainder);
+            std::string part = digits.toString();
+            consume(std::string(count - part.size(), '0') + part);
+        }
+    }
+
+    std::string asDecimal(size_t presision = 0) const {
+        std::string ans;
+        decimalChunks(presision, [&ans](const std::string& part) {
+            ans += part;
+        });
         return ans;
     }
 
+    void writeDecimal(std::ostream& out, size_t presision = 0) const {
+        decimalChunks(presision, [&out](const std::string& part) {
+            out << part;
+        });
+    }
+
     explicit operator double() const {
+        if (isSmall) {
+            return static_cast<double>(smallNumerator) / static_cast<double>(smallDenominator);
+        }
         long long integer_part = static_cast<long long>(numerator / denominator);
-        BigInteger remainder = numerator % denominator;
+        BigInteger remainder = numerator;
+        remainder %= denominator;
         double coeff = 1e-9;
         double answer = integer_part;
         for (int i = 0; i < 35 && remainder != 0; ++i) {
@@ -606,11 +1127,202 @@ Rational operator/(const Rational& first, const Rational& second) {
     return copy;
 }
 
+Rational sum(std::span<const Rational> values, bool parallel = false) {
+    if (values.empty()) {
+        return Rational(0);
+    }
+    return Rational::sumTree([values](size_t index) {
+        return values[index];
+    }, 0, values.size(), Rational::threadsFor(parallel));
+}
+
+Rational dot(std::span<const Rational> first, std::span<const Rational> second, bool parallel = false) {
+    if (first.size() != second.size()) {
+        throw std::invalid_argument("vectors of different sizes");
+    }
+    if (first.empty()) {
+        return Rational(0);
+    }
+    return Rational::sumTree([first, second](size_t index) {
+        return first[index] * second[index];
+    }, 0, first.size(), Rational::threadsFor(parallel));
+}
+
+class ConvergentIterator {
+private:
+    //while the convergents fit in long long the state lives in the small fields, as in limitDenominator,
+    //and moves to the BigInteger ones once a step would overflow
+    bool isSmall = true;
+    long long smallNumerator = 0;
+    long long smallDenominator = 0;
+    long long smallQuotient = 0;
+    long long smallPreviousNumerator = 0;
+    long long smallPreviousDenominator = 1;
+    long long smallCurrentNumerator = 1;
+    long long smallCurrentDenominator = 0;
+    BigInteger numerator;
+    BigInteger denominator;
+    BigInteger quotient;
+    BigInteger previous_numerator = 0;
+    BigInteger previous_denominator = 1;
+    BigInteger current_numerator = 1;
+    BigInteger current_denominator = 0;
+    Rational convergent;
+    bool finished = true;
+
+    bool smallStep() {
+        long long num = smallNumerator;
+        long long den = smallDenominator;
+        long long quot;
+        euclidStep(num, den, quot);
+        long long next_numerator;
+        long long next_denominator;
+        if (__builtin_mul_overflow(quot, smallCurrentNumerator, &next_numerator) ||
+            __builtin_add_overflow(next_numerator, smallPreviousNumerator, &next_numerator) ||
+            __builtin_mul_overflow(quot, smallCurrentDenominator, &next_denominator) ||
+            __builtin_add_overflow(next_denominator, smallPreviousDenominator, &next_denominator)) {
+            return false;
+        }
+        smallNumerator = num;
+        smallDenominator = den;
+        smallQuotient = quot;
+        smallPreviousNumerator = smallCurrentNumerator;
+        smallPreviousDenominator = smallCurrentDenominator;
+        smallCurrentNumerator = next_numerator;
+        smallCurrentDenominator = next_denominator;
+        convergent = Rational::fromReduced(next_numerator, next_denominator);
+        return true;
+    }
+
+    void promote() {
+        isSmall = false;
+        numerator = smallNumerator;
+        denominator = smallDenominator;
+        quotient = smallQuotient;
+        previous_numerator = smallPreviousNumerator;
+        previous_denominator = smallPreviousDenominator;
+        current_numerator = smallCurrentNumerator;
+        current_denominator = smallCurrentDenominator;
+    }
+public:
+    using value_type = Rational;
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using reference = const Rational&;
+    using pointer = const Rational*;
+
+    ConvergentIterator() = default;
+
+    explicit ConvergentIterator(const Rational& value) : isSmall(value.isSmall), finished(false) {
+        if (isSmall) {
+            smallNumerator = value.smallNumerator;
+            smallDenominator = value.smallDenominator;
+        }
+        else {
+            numerator = value.numerator;
+            denominator = value.denominator;
+        }
+        ++(*this);
+    }
+
+    ConvergentIterator& operator++() {
+        if (isSmall) {
+            if (smallDenominator == 0) {
+                finished = true;
+                return *this;
+            }
+            if (smallStep()) {
+                return *this;
+            }
+            promote();
+        }
+        if (denominator == 0) {
+            finished = true;
+            return *this;
+        }
+        euclidStep(numerator, denominator, quotient);
+        BigInteger next_numerator = previous_numerator + quotient * current_numerator;
+        BigInteger next_denominator = previous_denominator + quotient * current_denominator;
+        previous_numerator.swap(current_numerator);
+        previous_denominator.swap(current_denominator);
+        current_numerator.swap(next_numerator);
+        current_denominator.swap(next_denominator);
+        convergent = Rational::fromReduced(current_numerator, current_denominator);
+        return *this;
+    }
+
+    ConvergentIterator operator++(int) {
+        ConvergentIterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    reference operator*() const {
+        return convergent;
+    }
+
+    pointer operator->() const {
+        return &convergent;
+    }
+
+    BigInteger partialQuotient() const {
+        return isSmall ? BigInteger(smallQuotient) : quotient;
+    }
+
+    bool operator==(const ConvergentIterator& other) const {
+        return finished == other.finished;
+    }
+
+    bool operator!=(const ConvergentIterator& other) const {
+        return finished != other.finished;
+    }
+};
+
+class ConvergentRange {
+private:
+    Rational value;
+public:
+    explicit ConvergentRange(const Rational& value) : value(value) {}
+
+    ConvergentIterator begin() const {
+        return ConvergentIterator(value);
+    }
+
+    ConvergentIterator end() const {
+        return ConvergentIterator();
+    }
+};
+
+ConvergentRange Rational::convergents() const {
+    return ConvergentRange(*this);
+}
+
 bool Rational::operator==(const Rational& other) const {
-    return (numerator * other.denominator == other.numerator * denominator);
+    if (isSmall != other.isSmall) {
+        return false;
+    }
+    if (isSmall) {
+        return smallNumerator == other.smallNumerator && smallDenominator == other.smallDenominator;
+    }
+    return numerator == other.numerator && denominator == other.denominator;
 }
 
 bool Rational::operator<(const Rational& other) const {
+    if (isSmall && other.isSmall) {
+        return static_cast<__int128>(smallNumerator) * other.smallDenominator < static_cast<__int128>(other.smallNumerator) * smallDenominator;
+    }
+    int first_sign = sign();
+    int second_sign = other.sign();
+    if (first_sign != second_sign) {
+        return first_sign < second_sign;
+    }
+    int order = compareMagnitudes(other);
+    if (order != 0) {
+        return (order < 0) != (first_sign < 0);
+    }
+    if (isSmall || other.isSmall) {
+        return bigCopy() < other.bigCopy();
+    }
     return (numerator * other.denominator < other.numerator* denominator);
 }
 
@@ -1,3 +1,4 @@
+#pragma once
 #include <iostream>
 #include <vector>
 #include <string>
@@ -6,6 +7,25 @@
 #include <iomanip>
 #include <random>
 #include <algorithm>
+#include <numeric>
+#include <climits>
+#include <span>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <exception>
+#include <iterator>
+#include <utility>
+#include <tuple>
+#include <cstdint>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 class BigInteger {
 private:
@@ -23,9 +43,23 @@ private:
         }
     }
 
+    //the quotient is guessed from the leading limbs and then checked by a short binary search
     int find_div(const BigInteger& other) const {
-        int left = 0;
-        int right = mod;
+        if ((*this) < other) {
+            return 0;
+        }
+        size_t used = std::min<size_t>(digits.size(), 3);
+        size_t other_used = std::min<size_t>(other.digits.size(), 3);
+        double shift = static_cast<double>(digits.size() - used) - static_cast<double>(other.digits.size() - other_used);
+        double estimate = leadingDigits(used) / other.leadingDigits(other_used) * std::pow(static_cast<double>(mod), shift);
+        int left = static_cast<int>(std::max(estimate - 2, 0.0));
+        int right = static_cast<int>(std::min(estimate + 3, static_cast<double>(mod)));
+        if (other * left > (*this)) {
+            left = 0;
+        }
+        if (right < mod && other * right <= (*this)) {
+            right = mod;
+        }
         while (right - left > 1) {
             int mid = (left + right) / 2;
             BigInteger result = other;
@@ -251,8 +285,13 @@ public:
             delete_zero();
             return *this;
         }
-        digits[0] = (mod - digits[0]) % mod;
-        for (size_t i = 1; i < digits.size(); ++i) {
+        //the limbs hold mod^size - |result|: negate it, the zero limbs at the bottom borrow nothing
+        size_t first_nonzero = 0;
+        while (digits[first_nonzero] == 0) {
+            ++first_nonzero;
+        }
+        digits[first_nonzero] = mod - digits[first_nonzero];
+        for (size_t i = first_nonzero + 1; i < digits.size(); ++i) {
             digits[i] = mod - 1 - digits[i];
         }
         ChangeSign();
@@ -291,12 +330,14 @@ public:
 
     BigInteger& operator*=(const BigInteger& other) {
         BigInteger copy = *this;
+        //x *= x must not read other after *this is cleared
+        const BigInteger& multiplier = this == &other ? copy : other;
         *this = 0;
-        for (size_t i = other.digits.size(); i > 0; --i) {
+        for (size_t i = multiplier.digits.size(); i > 0; --i) {
             *this *= mod;
-            *this += copy * other.digits[i - 1];
+            *this += copy * multiplier.digits[i - 1];
         }
-        if (other.isNegative) {
+        if (multiplier.isNegative) {
             ChangeSign();
         }
         delete_zero();
@@ -334,26 +375,36 @@ public:
 
     BigInteger& operator%=(const BigInteger& other) {
         BigInteger div = (*this);
-        div /= other;
-        BigInteger result = other;
-        result *= div;
-        *this -= result;
+        div.divmod(other, *this);
+        return *this;
+    }
+
+    BigInteger& divmod(const BigInteger& other, BigInteger& remainder);
+
+    BigInteger& shiftLimbs(size_t count) {
+        if (digits.size() > 0) {
+            digits.insert(digits.begin(), count, 0);
+        }
         return *this;
     }
 
+    BigInteger& multiplyByPowerOfTen(size_t power) {
+        int small_power = 1;
+        for (size_t i = 0; i < power % max_length; ++i) {
+            small_power *= 10;
+        }
+        *this *= small_power;
+        return shiftLimbs(power / max_length);
+    }
+
     explicit operator bool() const {
         return (digits.size() != 0);
     }
 
     explicit operator long long() const {
-        if (digits.size() == 0) {
-            return 0;
-        }
         long long ans = 0;
-        long long kmod = 1;
-        for (size_t i = 0; i < digits.size(); ++i) {
-            ans += static_cast<long long>(digits[i]) * kmod;
-            kmod *= mod;
+        for (size_t i = digits.size(); i > 0; --i) {
+            ans = ans * mod + digits[i - 1];
         }
         if (isNegative) {
             return -ans;
@@ -361,7 +412,42 @@ public:
         return ans;
     }
 
-    bool IsNegative() {
+    size_t length() const {
+        return digits.size();
+    }
+
+    //the value modulo a word-size modulus, in [0, modulus)
+    uint64_t residue(uint64_t modulus) const {
+        unsigned __int128 ans = 0;
+        for (size_t i = digits.size(); i > 0; --i) {
+            ans = (ans * mod + digits[i - 1]) % modulus;
+        }
+        uint64_t value = static_cast<uint64_t>(ans);
+        return (isNegative && value != 0) ? modulus - value : value;
+    }
+
+    double leadingDigits(size_t count) const {
+        double ans = 0;
+        for (size_t i = digits.size(); i > 0 && i + count > digits.size(); --i) {
+            ans = ans * mod + digits[i - 1];
+        }
+        return ans;
+    }
+
+    bool fitsLongLong() const {
+        static const int max_digits[3] = {854775807, 223372036, 9};
+        if (digits.size() != 3) {
+            return digits.size() < 3;
+        }
+        for (size_t i = 3; i > 0; --i) {
+            if (digits[i - 1] != max_digits[i - 1]) {
+                return digits[i - 1] < max_digits[i - 1];
+            }
+        }
+        return true;
+    }
+
+    bool IsNegative() const {
         return isNegative;
     }
 
@@ -418,12 +504,17 @@ std::istream& operator>>(std::istream& in, BigInteger& num) {
     return in;
 }
 
-BigInteger& BigInteger::operator/=(const BigInteger& other) {
+BigInteger& BigInteger::divmod(const BigInteger& other, BigInteger& remainder) {
+    bool remainder_negative = isNegative;
     if (other.isNegative) {
         ChangeSign();
     }
     BigInteger initial_part = 0;
     int index = digits.size() - 1;
+    //the leading limbs below the divisor's length give zero quotient digits, so they are taken at once
+    size_t skipped = other.digits.empty() ? 0 : std::min(digits.size(), other.digits.size() - 1);
+    initial_part.digits.assign(digits.end() - skipped, digits.end());
+    index -= skipped;
     std::vector<int>result_digits;
     BigInteger AbsOther = other;
     AbsOther.isNegative = false;
@@ -438,9 +529,18 @@ BigInteger& BigInteger::operator/=(const BigInteger& other) {
     std::reverse(result_digits.begin(), result_digits.end());
     digits = result_digits;
     delete_zero();
+    remainder.swap(initial_part);
+    if (remainder_negative && remainder.digits.size() > 0) {
+        remainder.ChangeSign();
+    }
     return *this;
 }
 
+BigInteger& BigInteger::operator/=(const BigInteger& other) {
+    BigInteger remainder;
+    return divmod(other, remainder);
+}
+
 BigInteger gcd(BigInteger first, BigInteger second) {
     if (first.IsNegative()) {
         first.ChangeSign();
@@ -457,8 +557,39 @@ BigInteger gcd(BigInteger first, BigInteger second) {
     return gcd(second, first % second);
 }
 
+//one step of the Euclidean algorithm: quotient = floor(first / second), (first, second) = (second, first mod second)
+void euclidStep(long long& first, long long& second, long long& quotient) {
+    quotient = first / second;
+    long long remainder = first % second;
+    if (remainder < 0) {
+        --quotient;
+        remainder += second;
+    }
+    first = second;
+    second = remainder;
+}
+
+void euclidStep(BigInteger& first, BigInteger& second, BigInteger& quotient) {
+    BigInteger remainder;
+    quotient = first;
+    quotient.divmod(second, remainder);
+    if (remainder < 0) {
+        --quotient;
+        remainder += second;
+    }
+    first.swap(second);
+    second.swap(remainder);
+}
+
+class ConvergentIterator;
+
+class ConvergentRange;
+
 class Rational {
 private:
+    long long smallNumerator = 0;
+    long long smallDenominator = 1;
+    bool isSmall = true;
     BigInteger numerator;
     BigInteger denominator;
 
@@ -471,82 +602,424 @@ private:
             numerator.ChangeSign();
         }
     }
+
+    void promote() {
+        if (!isSmall) {
+            return;
+        }
+        numerator = smallNumerator;
+        denominator = smallDenominator;
+        isSmall = false;
+    }
+
+    void shrink() {
+        if (isSmall || !numerator.fitsLongLong() || !denominator.fitsLongLong()) {
+            return;
+        }
+        smallNumerator = static_cast<long long>(numerator);
+        smallDenominator = static_cast<long long>(denominator);
+        numerator = BigInteger();
+        denominator = BigInteger();
+        isSmall = true;
+    }
+
+    //small fractions are kept reduced with a positive denominator and a numerator other than LLONG_MIN,
+    //so the helpers below may negate freely; false means an overflow and the caller switches to BigInteger
+    bool addSmall(long long a, long long b, long long c, long long d) {
+        long long g = std::gcd(b, d);
+        long long left = 0;
+        long long right = 0;
+        long long num = 0;
+        long long den = 0;
+        if (__builtin_mul_overflow(a, d / g, &left) || __builtin_mul_overflow(c, b / g, &right) ||
+            __builtin_add_overflow(left, right, &num) || __builtin_mul_overflow(b / g, d, &den) || num == LLONG_MIN) {
+            return false;
+        }
+        g = std::gcd(num, g);
+        smallNumerator = num / g;
+        smallDenominator = den / g;
+        return true;
+    }
+
+    bool mulSmall(long long a, long long b, long long c, long long d) {
+        if (a == 0 || c == 0) {
+            smallNumerator = 0;
+            smallDenominator = 1;
+            return true;
+        }
+        long long g1 = std::gcd(a, d);
+        long long g2 = std::gcd(c, b);
+        long long num = 0;
+        long long den = 0;
+        if (__builtin_mul_overflow(a / g1, c / g2, &num) || __builtin_mul_overflow(b / g2, d / g1, &den) ||
+            num == LLONG_MIN || den == LLONG_MIN) {
+            return false;
+        }
+        if (den < 0) {
+            num = -num;
+            den = -den;
+        }
+        smallNumerator = num;
+        smallDenominator = den;
+        return true;
+    }
+
+    static long long limbCount(long long value) {
+        long long count = 0;
+        for (; value != 0; value /= 1000000000) {
+            ++count;
+        }
+        return count;
+    }
+
+    //the absolute value lies strictly between 1e9^(scale() - 1) and 1e9^(scale() + 1)
+    long long scale() const {
+        if (isSmall) {
+            return limbCount(smallNumerator) - limbCount(smallDenominator);
+        }
+        return static_cast<long long>(numerator.length()) - static_cast<long long>(denominator.length());
+    }
+
+    //the absolute value is approximately mantissa(exponent) * 1e9^exponent
+    double mantissa(long long& exponent) const {
+        if (isSmall) {
+            exponent = 0;
+            return std::abs(static_cast<double>(smallNumerator)) / static_cast<double>(smallDenominator);
+        }
+        size_t numerator_used = std::min<size_t>(numerator.length(), 3);
+        size_t denominator_used = std::min<size_t>(denominator.length(), 3);
+        exponent = static_cast<long long>(numerator.length() - numerator_used) - static_cast<long long>(denominator.length() - denominator_used);
+        return numerator.leadingDigits(numerator_used) / denominator.leadingDigits(denominator_used);
+    }
+
+    //-1 or 1 when the magnitudes are surely ordered, 0 when only exact arithmetic can tell
+    int compareMagnitudes(const Rational& other) const {
+        long long scale_difference = scale() - other.scale();
+        if (scale_difference >= 2) {
+            return 1;
+        }
+        if (scale_difference <= -2) {
+            return -1;
+        }
+        long long first_exponent = 0;
+        long long second_exponent = 0;
+        double first_mantissa = mantissa(first_exponent);
+        double second_mantissa = other.mantissa(second_exponent);
+        double ratio = first_mantissa / second_mantissa * std::pow(1e9, static_cast<double>(first_exponent - second_exponent));
+        if (ratio > 1 + 1e-12) {
+            return 1;
+        }
+        if (ratio < 1 - 1e-12) {
+            return -1;
+        }
+        return 0;
+    }
+
+    Rational bigCopy() const {
+        Rational copy = *this;
+        copy.promote();
+        return copy;
+    }
+
+    //with g = gcd(d1, d2) the sum is (n1 (d2 / g) + n2 (d1 / g)) / (d1 / g * d2), where only factors of g
+    //can cancel
+    void addBig(const Rational& other) {
+        BigInteger gcd_denominator = gcd(denominator, other.denominator);
+        if (gcd_denominator == 1) {
+            numerator = numerator * other.denominator + other.numerator * denominator;
+            denominator *= other.denominator;
+            return;
+        }
+        BigInteger cofactor = denominator / gcd_denominator;
+        BigInteger sum = numerator * (other.denominator / gcd_denominator) + other.numerator * cofactor;
+        if (!sum) {
+            numerator = BigInteger();
+            denominator = 1;
+            return;
+        }
+        BigInteger common = gcd(sum, gcd_denominator);
+        numerator = sum / common;
+        denominator = cofactor * (other.denominator / common);
+    }
+
+    //the cross gcds cancel before the products are formed, so the result is reduced and the factors stay small
+    void mulBig(const BigInteger& other_numerator, const BigInteger& other_denominator) {
+        BigInteger gcd1 = gcd(numerator, other_denominator);
+        BigInteger gcd2 = gcd(other_numerator, denominator);
+        BigInteger product = (numerator / gcd1) * (other_numerator / gcd2);
+        denominator = (denominator / gcd2) * (other_denominator / gcd1);
+        numerator = std::move(product);
+        if (denominator.IsNegative()) {
+            denominator.ChangeSign();
+            numerator.ChangeSign();
+        }
+    }
+
+    void addReducingOnce(const Rational& other) {
+        if (isSmall && other.isSmall && addSmall(smallNumerator, smallDenominator, other.smallNumerator, other.smallDenominator)) {
+            return;
+        }
+        promote();
+        if (other.isSmall) {
+            addReducingOnce(other.bigCopy());
+            return;
+        }
+        numerator = numerator * other.denominator + other.numerator * denominator;
+        denominator *= other.denominator;
+        norm();
+        shrink();
+    }
+
+    //sums term(left), ..., term(right - 1) as a balanced tree, the halves of big ranges go to separate threads
+    template <typename Term>
+    static Rational sumTree(const Term& term, size_t left, size_t right, size_t threads) {
+        static const size_t parallel_threshold = 256;
+        if (right - left == 1) {
+            return term(left);
+        }
+        size_t middle = left + (right - left) / 2;
+        Rational first;
+        Rational second;
+        if (threads > 1 && right - left >= parallel_threshold) {
+            std::future<Rational> first_half = std::async(std::launch::async, [&] {
+                return sumTree(term, left, middle, threads / 2);
+            });
+            second = sumTree(term, middle, right, threads - threads / 2);
+            first = first_half.get();
+        }
+        else {
+            first = sumTree(term, left, middle, 1);
+            second = sumTree(term, middle, right, 1);
+        }
+        first.addReducingOnce(second);
+        return first;
+    }
+
+    static size_t threadsFor(bool parallel) {
+        return parallel ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : 1;
+    }
+
+    static Rational fromReduced(long long num, long long den) {
+        Rational ans;
+        ans.smallNumerator = num;
+        ans.smallDenominator = den;
+        return ans;
+    }
+
+    static Rational fromReduced(const BigInteger& num, const BigInteger& den) {
+        Rational ans;
+        ans.isSmall = false;
+        ans.numerator = num;
+        ans.denominator = den;
+        ans.shrink();
+        return ans;
+    }
+
+    //walks the convergents p/q of num/den while q <= max_denominator and then picks the closer of
+    //the last convergent and the largest semiconvergent that still fits
+    template <typename Integer>
+    Rational closestWithDenominator(Integer num, Integer den, const Integer& max_denominator) const {
+        Integer previous_numerator = 0;
+        Integer previous_denominator = 1;
+        Integer current_numerator = 1;
+        Integer current_denominator = 0;
+        Integer quotient = 0;
+        while (true) {
+            euclidStep(num, den, quotient);
+            Integer next_denominator = previous_denominator + quotient * current_denominator;
+            if (next_denominator > max_denominator) {
+                break;
+            }
+            Integer next_numerator = previous_numerator + quotient * current_numerator;
+            std::swap(previous_numerator, current_numerator);
+            std::swap(previous_denominator, current_denominator);
+            std::swap(current_numerator, next_numerator);
+            std::swap(current_denominator, next_denominator);
+        }
+        Integer k = (max_denominator - previous_denominator) / current_denominator;
+        Rational semiconvergent = fromReduced(previous_numerator + k * current_numerator, previous_denominator + k * current_denominator);
+        Rational convergent = fromReduced(current_numerator, current_denominator);
+        Rational semiconvergent_error = semiconvergent;
+        Rational convergent_error = convergent;
+        semiconvergent_error -= *this;
+        convergent_error -= *this;
+        if (semiconvergent_error.sign() < 0) {
+            semiconvergent_error = -semiconvergent_error;
+        }
+        if (convergent_error.sign() < 0) {
+            convergent_error = -convergent_error;
+        }
+        return semiconvergent_error < convergent_error ? semiconvergent : convergent;
+    }
+
+    friend class ConvergentIterator;
+
+    friend Rational sum(std::span<const Rational> values, bool parallel);
+
+    friend Rational dot(std::span<const Rational> first, std::span<const Rational> second, bool parallel);
 public:
-    Rational() : numerator(0), denominator(1) {}
+    Rational() = default;
 
     Rational(const Rational& ration) = default;
 
-    Rational(int num) : numerator(num), denominator(1) {}
+    Rational(Rational&& ration) = default;
 
-    Rational(const BigInteger& num) : numerator(num), denominator(1) {}
+    Rational(int num) : smallNumerator(num) {}
 
-    Rational(const BigInteger& numerator, const BigInteger& denominator) : numerator(numerator), denominator(denominator) {
-        norm();
+    Rational(const BigInteger& num) : isSmall(false), numerator(num), denominator(1) {
+        shrink();
     }
 
-    Rational& operator=(const Rational& other) {
-        numerator = other.numerator;
-        denominator = other.denominator;
-        return *this;
+    Rational(const BigInteger& numerator, const BigInteger& denominator) : isSmall(false), numerator(numerator), denominator(denominator) {
+        norm();
+        shrink();
     }
 
+    Rational& operator=(const Rational& other) = default;
+
+    Rational& operator=(Rational&& other) = default;
+
     Rational operator-() const {
         Rational copy = *this;
-        copy.numerator = -copy.numerator;
+        if (isSmall) {
+            copy.smallNumerator = -copy.smallNumerator;
+        }
+        else {
+            copy.numerator = -copy.numerator;
+        }
         return copy;
     }
 
     Rational& operator+=(const Rational& other) {
-        BigInteger gcd_denominator = gcd(other.denominator, denominator);
-        numerator = numerator * other.denominator + other.numerator * denominator;
-        denominator *= other.denominator;
-        numerator /= gcd_denominator;
-        denominator /= gcd_denominator;
-        norm();
+        if (isSmall && other.isSmall && addSmall(smallNumerator, smallDenominator, other.smallNumerator, other.smallDenominator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            addBig(other.bigCopy());
+        }
+        else {
+            addBig(other);
+        }
+        shrink();
         return *this;
     }
 
     Rational& operator-=(const Rational& other) {
-        BigInteger gcd_denominator = gcd(other.denominator, denominator);
-        numerator = numerator * other.denominator - other.numerator * denominator;
-        denominator *= other.denominator;
-        numerator /= gcd_denominator;
-        denominator /= gcd_denominator;
-        norm();
+        if (isSmall && other.isSmall && addSmall(smallNumerator, smallDenominator, -other.smallNumerator, other.smallDenominator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            addBig(-other.bigCopy());
+        }
+        else {
+            addBig(-other);
+        }
+        shrink();
         return *this;
     }
 
     Rational& operator*=(const Rational& other) {
-        BigInteger gcd1 = gcd(numerator, other.denominator);
-        BigInteger gcd2 = gcd(other.numerator, denominator);
-        numerator *= other.numerator;
-        denominator *= other.denominator;
-        BigInteger div = gcd1 * gcd2;
-        numerator /= div;
-        denominator /= div;
-        if (denominator.IsNegative()) {
-            denominator.ChangeSign();
-            numerator.ChangeSign();
+        if (isSmall && other.isSmall && mulSmall(smallNumerator, smallDenominator, other.smallNumerator, other.smallDenominator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            mulBig(other.smallNumerator, other.smallDenominator);
+        }
+        else {
+            mulBig(other.numerator, other.denominator);
         }
+        shrink();
         return *this;
     }
 
     Rational& operator/=(const Rational& other) {
-        BigInteger gcd1 = gcd(numerator, other.numerator);
-        BigInteger gcd2 = gcd(other.denominator, denominator);
-        numerator *= other.denominator;
-        denominator *= other.numerator;
-        BigInteger div = gcd1 * gcd2;
-        numerator /= div;
-        denominator /= div;
-        if (denominator.IsNegative()) {
-            denominator.ChangeSign();
-            numerator.ChangeSign();
+        if (isSmall && other.isSmall && mulSmall(smallNumerator, smallDenominator, other.smallDenominator, other.smallNumerator)) {
+            return *this;
+        }
+        promote();
+        if (other.isSmall) {
+            mulBig(other.smallDenominator, other.smallNumerator);
+        }
+        else {
+            mulBig(other.denominator, other.numerator);
         }
+        shrink();
         return *this;
     }
 
+    //*this += first * second, or -= with subtract; no temporary fraction is made while everything fits in long long
+    Rational& addProduct(const Rational& first, const Rational& second, bool subtract = false) {
+        if (isSmall && first.isSmall && second.isSmall) {
+            long long num = smallNumerator;
+            long long den = smallDenominator;
+            if (mulSmall(first.smallNumerator, first.smallDenominator, second.smallNumerator, second.smallDenominator) &&
+                addSmall(num, den, subtract ? -smallNumerator : smallNumerator, smallDenominator)) {
+                return *this;
+            }
+            smallNumerator = num;
+            smallDenominator = den;
+        }
+        if (first.isZero() || second.isZero()) {
+            return *this;
+        }
+        Rational product = first;
+        product *= second;
+        if (subtract) {
+            product.negate();
+        }
+        return *this += product;
+    }
+
+    Rational& subtractProduct(const Rational& first, const Rational& second) {
+        return addProduct(first, second, true);
+    }
+
+    void negate() {
+        if (isSmall) {
+            smallNumerator = -smallNumerator;
+        }
+        else {
+            numerator.ChangeSign();
+        }
+    }
+
+    BigInteger getNumerator() const {
+        return isSmall ? BigInteger(smallNumerator) : numerator;
+    }
+
+    BigInteger getDenominator() const {
+        return isSmall ? BigInteger(smallDenominator) : denominator;
+    }
+
+    Rational limitDenominator(const BigInteger& max_denominator) const {
+        if (max_denominator < 1) {
+            throw std::invalid_argument("the maximal denominator must be positive");
+        }
+        if (isSmall) {
+            if (!max_denominator.fitsLongLong() || smallDenominator <= static_cast<long long>(max_denominator)) {
+                return *this;
+            }
+            return closestWithDenominator<long long>(smallNumerator, smallDenominator, static_cast<long long>(max_denominator));
+        }
+        if (denominator <= max_denominator) {
+            return *this;
+        }
+        return closestWithDenominator<BigInteger>(numerator, denominator, max_denominator);
+    }
+
+    ConvergentRange convergents() const;
+
+    bool isZero() const {
+        return isSmall && smallNumerator == 0;
+    }
+
     int sign() const {
+        if (isSmall) {
+            return (smallNumerator > 0) - (smallNumerator < 0);
+        }
         if (numerator > 0) {
             return 1;
         }
@@ -557,6 +1030,12 @@ public:
     }
 
     std::string toString() const {
+        if (isSmall) {
+            if (smallDenominator != 1) {
+                return std::to_string(smallNumerator) + '/' + std::to_string(smallDenominator);
+            }
+            return std::to_string(smallNumerator);
+        }
         if (denominator != 1) {
             return numerator.toString() + '/' + denominator.toString();
         }
@@ -565,44 +1044,73 @@ public:
         }
     }
 
-    std::string asDecimal(size_t presision = 0) const {
+    //the fraction is produced by long division in chunks of at least chunk_limbs limbs, each of them
+    //needs one shift by a power of ten and one divmod by the denominator
+    template <typename Consumer>
+    void decimalChunks(size_t presision, const Consumer& consume) const {
+        static const size_t chunk_limbs = 64;
+        if (isSmall) {
+            bigCopy().decimalChunks(presision, consume);
+            return;
+        }
         if (presision == 0) {
-            return (numerator / denominator).toString();
+            consume((numerator / denominator).toString());
+            return;
         }
-        std::string ans;
-        Rational copy = *this;
-        if (copy.numerator < 0) {
-            ans += '-';
-            copy = -copy;
+        if (numerator < 0) {
+            consume("-");
+        }
+        BigInteger remainder;
+        BigInteger integer_part = numerator;
+        integer_part.divmod(denominator, remainder);
+        if (remainder < 0) {
+            remainder.ChangeSign();
         }
-        BigInteger num = copy.numerator % copy.denominator;
-        for (size_t i = 0; i < presision; ++i) {
-            num *= 10;
+        if (integer_part < 0) {
+            integer_part.ChangeSign();
         }
-        std::string ans_first = (copy.numerator / copy.denominator).toString() + '.';
-        std::string ans_second = (num / copy.denominator).toString();
-        for (size_t i = 0; i < presision - ans_second.size(); ++i) {
-            ans_first += '0';
+        consume(integer_part.toString() + '.');
+        size_t chunk = std::max(chunk_limbs, denominator.length()) * 9;
+        for (size_t written = 0; written < presision; written += chunk) {
+            size_t count = std::min(chunk, presision - written);
+            BigInteger digits = remainder.multiplyByPowerOfTen(count);
+            digits.divmod(denominator, remainder);
+            std::string part = digits.toString();
+            consume(std::string(count - part.size(), '0') + part);
         }
-        ans += ans_first + ans_second;
+    }
+
+    std::string asDecimal(size_t presision = 0) const {
+        std::string ans;
+        decimalChunks(presision, [&ans](const std::string& part) {
+            ans += part;
+        });
         return ans;
     }
 
+    void writeDecimal(std::ostream& out, size_t presision = 0) const {
+        decimalChunks(presision, [&out](const std::string& part) {
+            out << part;
+        });
+    }
+
     explicit operator double() const {
-        BigInteger z = numerator / denominator;
-        long long z1 = static_cast<long long>(z);
-        BigInteger rem = numerator;
-        rem %= denominator;
+        if (isSmall) {
+            return static_cast<double>(smallNumerator) / static_cast<double>(smallDenominator);
+        }
+        long long integer_part = static_cast<long long>(numerator / denominator);
+        BigInteger remainder = numerator;
+        remainder %= denominator;
         double coeff = 1e-9;
-        double ans = z1;
-        for (int i = 0; i < 35 && rem != 0; ++i) {
-            rem *= 1e9;
-            long long z2 = static_cast<long long>(rem / denominator);
-            rem %= denominator;
-            ans += static_cast<double>(z2) * coeff;
+        double answer = integer_part;
+        for (int i = 0; i < 35 && remainder != 0; ++i) {
+            remainder *= 1e9;
+            long long division_result = static_cast<long long>(remainder / denominator);
+            remainder %= denominator;
+            answer += static_cast<double>(division_result) * coeff;
             coeff *= 1e-9;
         }
-        return ans;
+        return answer;
     }
 
     bool operator==(const Rational& other) const;
@@ -634,38 +1142,229 @@ Rational operator/(const Rational& first, const Rational& second) {
     return copy;
 }
 
-bool Rational::operator==(const Rational& other) const {
-    return (numerator * other.denominator == other.numerator * denominator);
+Rational sum(std::span<const Rational> values, bool parallel = false) {
+    if (values.empty()) {
+        return Rational(0);
+    }
+    return Rational::sumTree([values](size_t index) {
+        return values[index];
+    }, 0, values.size(), Rational::threadsFor(parallel));
 }
 
-bool Rational::operator<(const Rational& other) const {
-    return (numerator * other.denominator < other.numerator* denominator);
+Rational dot(std::span<const Rational> first, std::span<const Rational> second, bool parallel = false) {
+    if (first.size() != second.size()) {
+        throw std::invalid_argument("vectors of different sizes");
+    }
+    if (first.empty()) {
+        return Rational(0);
+    }
+    return Rational::sumTree([first, second](size_t index) {
+        return first[index] * second[index];
+    }, 0, first.size(), Rational::threadsFor(parallel));
 }
 
-bool operator>(const Rational& first, const Rational& second) {
-    return (second < first);
-}
+class ConvergentIterator {
+private:
+    //while the convergents fit in long long the state lives in the small fields, as in limitDenominator,
+    //and moves to the BigInteger ones once a step would overflow
+    bool isSmall = true;
+    long long smallNumerator = 0;
+    long long smallDenominator = 0;
+    long long smallQuotient = 0;
+    long long smallPreviousNumerator = 0;
+    long long smallPreviousDenominator = 1;
+    long long smallCurrentNumerator = 1;
+    long long smallCurrentDenominator = 0;
+    BigInteger numerator;
+    BigInteger denominator;
+    BigInteger quotient;
+    BigInteger previous_numerator = 0;
+    BigInteger previous_denominator = 1;
+    BigInteger current_numerator = 1;
+    BigInteger current_denominator = 0;
+    Rational convergent;
+    bool finished = true;
 
-bool operator<=(const Rational& first, const Rational& second) {
-    return !(first > second);
-}
+    bool smallStep() {
+        long long num = smallNumerator;
+        long long den = smallDenominator;
+        long long quot;
+        euclidStep(num, den, quot);
+        long long next_numerator;
+        long long next_denominator;
+        if (__builtin_mul_overflow(quot, smallCurrentNumerator, &next_numerator) ||
+            __builtin_add_overflow(next_numerator, smallPreviousNumerator, &next_numerator) ||
+            __builtin_mul_overflow(quot, smallCurrentDenominator, &next_denominator) ||
+            __builtin_add_overflow(next_denominator, smallPreviousDenominator, &next_denominator)) {
+            return false;
+        }
+        smallNumerator = num;
+        smallDenominator = den;
+        smallQuotient = quot;
+        smallPreviousNumerator = smallCurrentNumerator;
+        smallPreviousDenominator = smallCurrentDenominator;
+        smallCurrentNumerator = next_numerator;
+        smallCurrentDenominator = next_denominator;
+        convergent = Rational::fromReduced(next_numerator, next_denominator);
+        return true;
+    }
 
-bool operator>=(const Rational& first, const Rational& second) {
-    return !(first < second);
-}
+    void promote() {
+        isSmall = false;
+        numerator = smallNumerator;
+        denominator = smallDenominator;
+        quotient = smallQuotient;
+        previous_numerator = smallPreviousNumerator;
+        previous_denominator = smallPreviousDenominator;
+        current_numerator = smallCurrentNumerator;
+        current_denominator = smallCurrentDenominator;
+    }
+public:
+    using value_type = Rational;
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using reference = const Rational&;
+    using pointer = const Rational*;
 
-bool operator!=(const Rational& first, const Rational& second) {
-    return !(first == second);
-}
+    ConvergentIterator() = default;
 
-std::istream& operator>>(std::istream& in, Rational& num) {
-    std::string str;
-    in >> str;
-    std::string s1, s2;
-    bool flag = false;
-    for (size_t i = 0; i < str.size(); ++i) {
-        if (str[i] == '/') {
-            flag = true;
+    explicit ConvergentIterator(const Rational& value) : isSmall(value.isSmall), finished(false) {
+        if (isSmall) {
+            smallNumerator = value.smallNumerator;
+            smallDenominator = value.smallDenominator;
+        }
+        else {
+            numerator = value.numerator;
+            denominator = value.denominator;
+        }
+        ++(*this);
+    }
+
+    ConvergentIterator& operator++() {
+        if (isSmall) {
+            if (smallDenominator == 0) {
+                finished = true;
+                return *this;
+            }
+            if (smallStep()) {
+                return *this;
+            }
+            promote();
+        }
+        if (denominator == 0) {
+            finished = true;
+            return *this;
+        }
+        euclidStep(numerator, denominator, quotient);
+        BigInteger next_numerator = previous_numerator + quotient * current_numerator;
+        BigInteger next_denominator = previous_denominator + quotient * current_denominator;
+        previous_numerator.swap(current_numerator);
+        previous_denominator.swap(current_denominator);
+        current_numerator.swap(next_numerator);
+        current_denominator.swap(next_denominator);
+        convergent = Rational::fromReduced(current_numerator, current_denominator);
+        return *this;
+    }
+
+    ConvergentIterator operator++(int) {
+        ConvergentIterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    reference operator*() const {
+        return convergent;
+    }
+
+    pointer operator->() const {
+        return &convergent;
+    }
+
+    BigInteger partialQuotient() const {
+        return isSmall ? BigInteger(smallQuotient) : quotient;
+    }
+
+    bool operator==(const ConvergentIterator& other) const {
+        return finished == other.finished;
+    }
+
+    bool operator!=(const ConvergentIterator& other) const {
+        return finished != other.finished;
+    }
+};
+
+class ConvergentRange {
+private:
+    Rational value;
+public:
+    explicit ConvergentRange(const Rational& value) : value(value) {}
+
+    ConvergentIterator begin() const {
+        return ConvergentIterator(value);
+    }
+
+    ConvergentIterator end() const {
+        return ConvergentIterator();
+    }
+};
+
+ConvergentRange Rational::convergents() const {
+    return ConvergentRange(*this);
+}
+
+bool Rational::operator==(const Rational& other) const {
+    if (isSmall != other.isSmall) {
+        return false;
+    }
+    if (isSmall) {
+        return smallNumerator == other.smallNumerator && smallDenominator == other.smallDenominator;
+    }
+    return numerator == other.numerator && denominator == other.denominator;
+}
+
+bool Rational::operator<(const Rational& other) const {
+    if (isSmall && other.isSmall) {
+        return static_cast<__int128>(smallNumerator) * other.smallDenominator < static_cast<__int128>(other.smallNumerator) * smallDenominator;
+    }
+    int first_sign = sign();
+    int second_sign = other.sign();
+    if (first_sign != second_sign) {
+        return first_sign < second_sign;
+    }
+    int order = compareMagnitudes(other);
+    if (order != 0) {
+        return (order < 0) != (first_sign < 0);
+    }
+    if (isSmall || other.isSmall) {
+        return bigCopy() < other.bigCopy();
+    }
+    return (numerator * other.denominator < other.numerator* denominator);
+}
+
+bool operator>(const Rational& first, const Rational& second) {
+    return (second < first);
+}
+
+bool operator<=(const Rational& first, const Rational& second) {
+    return !(first > second);
+}
+
+bool operator>=(const Rational& first, const Rational& second) {
+    return !(first < second);
+}
+
+bool operator!=(const Rational& first, const Rational& second) {
+    return !(first == second);
+}
+
+std::istream& operator>>(std::istream& in, Rational& num) {
+    std::string str;
+    in >> str;
+    std::string s1, s2;
+    bool flag = false;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '/') {
+            flag = true;
         }
         else if (flag) {
             s2 += str[i];
@@ -686,56 +1385,317 @@ std::istream& operator>>(std::istream& in, Rational& num) {
 
 //The end of Biginteger and Rational
 
+constexpr uint64_t multiply_mod(uint64_t a, uint64_t b, uint64_t mod) {
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % mod);
+}
+
+constexpr uint64_t power_mod(uint64_t a, uint64_t k, uint64_t mod) {
+    uint64_t ans = 1 % mod;
+    for (; k > 0; k /= 2) {
+        if (k % 2 == 1) {
+            ans = multiply_mod(ans, a, mod);
+        }
+        a = multiply_mod(a, a, mod);
+    }
+    return ans;
+}
+
+//deterministic Miller-Rabin, these seven bases are enough for every 64-bit number
 constexpr bool is_prime(size_t N) {
-    for (size_t d = 2; d * d <= N; ++d) {
-        if (N % d == 0) {
+    if (N < 2) {
+        return false;
+    }
+    for (uint64_t p : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+        if (N % p == 0) {
+            return N == p;
+        }
+    }
+    uint64_t d = N - 1;
+    int s = 0;
+    for (; d % 2 == 0; d /= 2) {
+        ++s;
+    }
+    for (uint64_t base : {2, 325, 9375, 28178, 450775, 9780504, 1795265022}) {
+        uint64_t x = power_mod(base % N, d, N);
+        if (base % N == 0 || x == 1 || x == N - 1) {
+            continue;
+        }
+        bool composite = true;
+        for (int i = 1; i < s && composite; ++i) {
+            x = multiply_mod(x, x, N);
+            composite = (x != N - 1);
+        }
+        if (composite) {
             return false;
         }
     }
     return true;
 }
 
+//extended Euclid, returns 0 when value is not invertible
+template <typename Unsigned>
+constexpr Unsigned inverse_mod(Unsigned value, Unsigned mod) {
+    using Signed = std::conditional_t<sizeof(Unsigned) <= 4, long long, __int128>;
+    Unsigned remainder = mod;
+    Unsigned next_remainder = value;
+    Signed coefficient = 0;
+    Signed next_coefficient = 1;
+    while (next_remainder != 0) {
+        Unsigned quotient = remainder / next_remainder;
+        Unsigned new_remainder = remainder - quotient * next_remainder;
+        Signed new_coefficient = coefficient - static_cast<Signed>(quotient) * next_coefficient;
+        remainder = next_remainder;
+        next_remainder = new_remainder;
+        coefficient = next_coefficient;
+        next_coefficient = new_coefficient;
+    }
+    if (remainder != 1) {
+        return 0;
+    }
+    return static_cast<Unsigned>(coefficient < 0 ? coefficient + static_cast<Signed>(mod) : coefficient);
+}
+
+//Montgomery form x * 2^32 mod mod, for odd moduli below 2^31
+struct MontgomeryReduction32 {
+    using value_type = uint32_t;
+
+    uint32_t mod;
+    uint32_t inverse;
+    uint32_t r_squared;
+
+    static constexpr uint32_t inverseModPowerOfTwo(uint32_t mod) {
+        uint32_t inverse = mod;
+        for (int i = 0; i < 4; ++i) {
+            inverse *= 2 - mod * inverse;
+        }
+        return inverse;
+    }
+
+    constexpr explicit MontgomeryReduction32(uint32_t mod) : mod(mod), inverse(inverseModPowerOfTwo(mod)),
+        r_squared(static_cast<uint32_t>((UINT64_MAX % mod + 1) % mod)) {}
+
+    //t < mod * 2^32, returns t / 2^32 mod mod
+    constexpr uint32_t reduce(uint64_t t) const {
+        uint32_t m = static_cast<uint32_t>(t) * inverse;
+        uint32_t high = static_cast<uint32_t>(t >> 32);
+        uint32_t correction = static_cast<uint32_t>((static_cast<uint64_t>(m) * mod) >> 32);
+        return high - correction + (high < correction ? mod : 0);
+    }
+
+    constexpr uint32_t multiply(uint32_t a, uint32_t b) const {
+        return reduce(static_cast<uint64_t>(a) * b);
+    }
+
+    constexpr uint32_t add(uint32_t a, uint32_t b) const {
+        return subtract(a, mod - b);
+    }
+
+    constexpr uint32_t subtract(uint32_t a, uint32_t b) const {
+        return a - b + (a < b ? mod : 0);
+    }
+
+    constexpr uint32_t transform(uint32_t value) const {
+        return multiply(value, r_squared);
+    }
+
+    constexpr uint32_t restore(uint32_t value) const {
+        return reduce(value);
+    }
+};
+
+//Barrett reduction with factor = ceil(2^64 / mod), used for even moduli below 2^31
+struct BarrettReduction32 {
+    using value_type = uint32_t;
+
+    uint32_t mod;
+    uint64_t factor;
+
+    constexpr explicit BarrettReduction32(uint32_t mod) : mod(mod), factor(UINT64_MAX / mod + 1) {}
+
+    //t < mod^2
+    constexpr uint32_t reduce(uint64_t t) const {
+        uint64_t quotient = static_cast<uint64_t>((static_cast<unsigned __int128>(t) * factor) >> 64);
+        uint64_t product = quotient * mod;
+        return static_cast<uint32_t>(t - product + (t < product ? mod : 0));
+    }
+
+    constexpr uint32_t multiply(uint32_t a, uint32_t b) const {
+        return reduce(static_cast<uint64_t>(a) * b);
+    }
+
+    constexpr uint32_t add(uint32_t a, uint32_t b) const {
+        return subtract(a, mod - b);
+    }
+
+    constexpr uint32_t subtract(uint32_t a, uint32_t b) const {
+        return a - b + (a < b ? mod : 0);
+    }
+
+    constexpr uint32_t transform(uint32_t value) const {
+        return value;
+    }
+
+    constexpr uint32_t restore(uint32_t value) const {
+        return value;
+    }
+};
+
+//Montgomery form x * 2^64 mod mod with 128-bit products, for odd moduli from 2^31 on
+struct MontgomeryReduction64 {
+    using value_type = uint64_t;
+
+    uint64_t mod;
+    uint64_t inverse;
+    uint64_t r_squared;
+
+    static constexpr uint64_t inverseModPowerOfTwo(uint64_t mod) {
+        uint64_t inverse = mod;
+        for (int i = 0; i < 5; ++i) {
+            inverse *= 2 - mod * inverse;
+        }
+        return inverse;
+    }
+
+    constexpr explicit MontgomeryReduction64(uint64_t mod) : mod(mod), inverse(inverseModPowerOfTwo(mod)),
+        r_squared(static_cast<uint64_t>((~static_cast<unsigned __int128>(0) % mod + 1) % mod)) {}
+
+    //t < mod * 2^64, returns t / 2^64 mod mod
+    constexpr uint64_t reduce(unsigned __int128 t) const {
+        uint64_t m = static_cast<uint64_t>(t) * inverse;
+        uint64_t high = static_cast<uint64_t>(t >> 64);
+        uint64_t correction = static_cast<uint64_t>((static_cast<unsigned __int128>(m) * mod) >> 64);
+        return high - correction + (high < correction ? mod : 0);
+    }
+
+    constexpr uint64_t multiply(uint64_t a, uint64_t b) const {
+        return reduce(static_cast<unsigned __int128>(a) * b);
+    }
+
+    constexpr uint64_t subtract(uint64_t a, uint64_t b) const {
+        return a - b + (a < b ? mod : 0);
+    }
+
+    constexpr uint64_t add(uint64_t a, uint64_t b) const {
+        return subtract(a, mod - b);
+    }
+
+    constexpr uint64_t transform(uint64_t value) const {
+        return multiply(value, r_squared);
+    }
+
+    constexpr uint64_t restore(uint64_t value) const {
+        return reduce(value);
+    }
+};
+
+//plain 128-bit remainder, only for even moduli from 2^31 on
+struct RemainderReduction64 {
+    using value_type = uint64_t;
+
+    uint64_t mod;
+
+    constexpr explicit RemainderReduction64(uint64_t mod) : mod(mod) {}
+
+    constexpr uint64_t multiply(uint64_t a, uint64_t b) const {
+        return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % mod);
+    }
+
+    constexpr uint64_t subtract(uint64_t a, uint64_t b) const {
+        return a - b + (a < b ? mod : 0);
+    }
+
+    constexpr uint64_t add(uint64_t a, uint64_t b) const {
+        return subtract(a, mod - b);
+    }
+
+    constexpr uint64_t transform(uint64_t value) const {
+        return value;
+    }
+
+    constexpr uint64_t restore(uint64_t value) const {
+        return value;
+    }
+};
+
+template <size_t N>
+using ResidueReduction = std::conditional_t<(static_cast<uint64_t>(N) < (uint64_t(1) << 31)),
+    std::conditional_t<N % 2 == 1, MontgomeryReduction32, BarrettReduction32>,
+    std::conditional_t<N % 2 == 1, MontgomeryReduction64, RemainderReduction64>>;
+
+template <size_t N>
+struct ResidueKernels;
+
 template <size_t N>
 class Residue {
 private:
-    int x;
+    using Reduction = ResidueReduction<N>;
+    using value_type = typename Reduction::value_type;
+
+    static constexpr Reduction reduction = Reduction(N);
+
+    value_type x;
+
+    friend struct ResidueKernels<N>;
+
+    static constexpr value_type normalize(long long value) {
+        if (value >= 0) {
+            return static_cast<uint64_t>(value) % N;
+        }
+        return N - 1 - static_cast<uint64_t>(-(value + 1)) % N;
+    }
 public:
     Residue() = default;
 
-    explicit Residue(int x) : x((x% static_cast<int>(N) + static_cast<int>(N)) % static_cast<int>(N)) {}
+    constexpr explicit Residue(long long x) : x(reduction.transform(normalize(x))) {}
 
-    Residue operator-() const {
-        return Residue((-x + N) % N);
+    constexpr Residue operator-() const {
+        Residue copy;
+        copy.x = reduction.subtract(0, x);
+        return copy;
     }
 
-    Residue& operator+=(const Residue& other) {
-        x = (x + other.x) % N;
+    constexpr Residue& operator+=(const Residue& other) {
+        x = reduction.add(x, other.x);
         return *this;
     }
 
-    Residue& operator-=(const Residue& other) {
-        x = (x + N - other.x) % N;
+    constexpr Residue& operator-=(const Residue& other) {
+        x = reduction.subtract(x, other.x);
         return *this;
     }
 
-    Residue& operator*=(const Residue& other) {
-        x = (static_cast<long long>(x) * other.x) % N;
+    constexpr Residue& operator*=(const Residue& other) {
+        x = reduction.multiply(x, other.x);
         return *this;
     }
 
-    Residue& operator/=(const Residue& other);
+    constexpr Residue& operator/=(const Residue& other);
+
+    constexpr Residue inverse() const {
+        Residue ans;
+        ans.x = reduction.transform(inverse_mod<value_type>(reduction.restore(x), N));
+        return ans;
+    }
+
+    constexpr bool operator==(const Residue& other) const { return x == other.x; }
+
+    constexpr bool operator!=(const Residue& other) const { return x != other.x; }
 
-    bool operator==(const Residue& other) const { return x == other.x; }
+    constexpr explicit operator int() const {
+        return reduction.restore(x);
+    }
 
-    bool operator!=(const Residue& other) const { return x != other.x; }
+    constexpr explicit operator long long() const {
+        return reduction.restore(x);
+    }
 
-    explicit operator int() const {
-        return x;
+    constexpr explicit operator unsigned long long() const {
+        return reduction.restore(x);
     }
 };
 
 template<size_t N>
-Residue<N> pown(const Residue<N>& n, int k) {
+constexpr Residue<N> pown(const Residue<N>& n, unsigned long long k) {
     Residue<N>ans(1);
     Residue<N>val = n;
     while (k > 0) {
@@ -749,33 +1709,57 @@ Residue<N> pown(const Residue<N>& n, int k) {
 }
 
 template <size_t N>
-Residue<N>& Residue<N>::operator/=(const Residue<N>& other) {
-    return (*this) *= pown(other, static_cast<int>(N) - 2);
+constexpr Residue<N>& Residue<N>::operator/=(const Residue<N>& other) {
+    static_assert(is_prime(N));
+    return (*this) *= other.inverse();
+}
+
+//Montgomery's trick: one inversion and 3n multiplications, zeros are left untouched
+template <size_t N>
+void batchInvert(std::span<Residue<N>> values) {
+    static_assert(is_prime(N));
+    std::vector<Residue<N>> prefix(values.size());
+    Residue<N> product(1);
+    for (size_t i = 0; i < values.size(); ++i) {
+        prefix[i] = product;
+        if (values[i] != Residue<N>(0)) {
+            product *= values[i];
+        }
+    }
+    Residue<N> inverse = product.inverse();
+    for (size_t i = values.size(); i > 0; --i) {
+        if (values[i - 1] == Residue<N>(0)) {
+            continue;
+        }
+        Residue<N> value = values[i - 1];
+        values[i - 1] = inverse * prefix[i - 1];
+        inverse *= value;
+    }
 }
 
 template <size_t N>
-Residue<N> operator+(const Residue<N>& first, const Residue<N>& second) {
+constexpr Residue<N> operator+(const Residue<N>& first, const Residue<N>& second) {
     Residue<N> copy = first;
     copy += second;
     return copy;
 }
 
 template <size_t N>
-Residue<N> operator-(const Residue<N>& first, const Residue<N>& second) {
+constexpr Residue<N> operator-(const Residue<N>& first, const Residue<N>& second) {
     Residue<N> copy = first;
     copy -= second;
     return copy;
 }
 
 template <size_t N>
-Residue<N> operator*(const Residue<N>& first, const Residue<N>& second) {
+constexpr Residue<N> operator*(const Residue<N>& first, const Residue<N>& second) {
     Residue<N> copy = first;
     copy *= second;
     return copy;
 }
 
 template <size_t N>
-Residue<N> operator/(const Residue<N>& first, const Residue<N>& second) {
+constexpr Residue<N> operator/(const Residue<N>& first, const Residue<N>& second) {
     Residue<N> copy = first;
     copy /= second;
     return copy;
@@ -783,306 +1767,3473 @@ Residue<N> operator/(const Residue<N>& first, const Residue<N>& second) {
 
 template<size_t N>
 std::ostream& operator<<(std::ostream& out, Residue<N> num) {
-    out << static_cast<int>(num);
+    out << static_cast<unsigned long long>(num);
     return out;
 }
 
-template<size_t M, size_t N = M, typename Field = Rational>
-class Matrix {
-private:
-    std::array<std::array<Field, N>, M> arr;
+#if defined(__x86_64__) || defined(__i386__)
+//eight 32-bit Montgomery products at once: even and odd lanes go through _mm256_mul_epu32 separately
+__attribute__((target("avx2"))) inline __m256i montgomeryMultiply8(__m256i a, __m256i b, __m256i mod, __m256i inverse) {
+    __m256i product_even = _mm256_mul_epu32(a, b);
+    __m256i product_odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    __m256i correction_even = _mm256_mul_epu32(_mm256_mul_epu32(product_even, inverse), mod);
+    __m256i correction_odd = _mm256_mul_epu32(_mm256_mul_epu32(product_odd, inverse), mod);
+    __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(product_even, 32), product_odd, 0b10101010);
+    __m256i correction = _mm256_blend_epi32(_mm256_srli_epi64(correction_even, 32), correction_odd, 0b10101010);
+    __m256i ans = _mm256_sub_epi32(high, correction);
+    return _mm256_add_epi32(ans, _mm256_and_si256(_mm256_cmpgt_epi32(correction, high), mod));
+}
 
-    Matrix& Gauss_method() {
-        size_t str_ind = 0;
-        for (size_t i = 0; i < N; ++i) {
-            if (str_ind == M) {
-                break;
-            }
-            size_t ind_whithout_zero = M;
-            for (size_t j = str_ind; j < M; ++j) {
-                if (arr[j][i] != Field(0)) {
-                    ind_whithout_zero = j;
-                    break;
-                }
-            }
-            if (ind_whithout_zero == M) {
-                continue;
-            }
-            if (ind_whithout_zero != str_ind) {
-                for (size_t q = i; q < N; ++q) {
-                    arr[str_ind][q] += arr[ind_whithout_zero][q];
-                }
-            }
-            for (size_t j = str_ind + 1; j < M; ++j) {
-                if (arr[j][i] == Field(0)) {
-                    continue;
-                }
-                Field coeff = arr[j][i] / arr[str_ind][i];
-                for (size_t q = i; q < N; ++q) {
-                    arr[j][q] -= arr[str_ind][q] * coeff;
-                }
+__attribute__((target("avx2"))) inline __m256i modularAdd8(__m256i a, __m256i b, __m256i mod) {
+    __m256i ans = _mm256_add_epi32(a, b);
+    return _mm256_min_epu32(ans, _mm256_sub_epi32(ans, mod));
+}
+
+__attribute__((target("avx2"))) inline __m256i modularSubtract8(__m256i a, __m256i b, __m256i mod) {
+    __m256i ans = _mm256_sub_epi32(a, b);
+    return _mm256_min_epu32(ans, _mm256_add_epi32(ans, mod));
+}
+
+inline bool hasAvx2() {
+    static const bool ans = __builtin_cpu_supports("avx2");
+    return ans;
+}
+#else
+inline bool hasAvx2() {
+    return false;
+}
+#endif
+
+//array kernels over Residue<N>; the AVX2 paths cover the 32-bit Montgomery moduli, everything else runs the scalar loops
+template <size_t N>
+struct ResidueKernels {
+    using Value = Residue<N>;
+
+    static constexpr bool vectorized = std::is_same_v<ResidueReduction<N>, MontgomeryReduction32>;
+
+    //below 2^31 raw products of representatives are under 2^62: sums of them are kept under 2^63 by taking off
+    //lazyLimit, a multiple of N^2, and reduced once at the end
+    static constexpr bool lazy = sizeof(typename ResidueReduction<N>::value_type) == 4;
+    static constexpr uint64_t lazyLimit = (uint64_t(1) << 63) / (uint64_t(N) * N) * (uint64_t(N) * N);
+
+    static void add(Value* first, const Value* second, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (vectorized) {
+            if (hasAvx2()) {
+                done = addAvx2(first, second, count);
             }
-            ++str_ind;
         }
-        return *this;
+#endif
+        for (size_t i = done; i < count; ++i) {
+            first[i] += second[i];
+        }
     }
-public:
-    Matrix() {
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                arr[i][j] = Field(0);
+
+    static void subtract(Value* first, const Value* second, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (vectorized) {
+            if (hasAvx2()) {
+                done = subtractAvx2(first, second, count);
             }
         }
-    };
-
-    Matrix(const std::array<std::array<Field, N>, M>& arr) : arr(arr) {}
+#endif
+        for (size_t i = done; i < count; ++i) {
+            first[i] -= second[i];
+        }
+    }
 
-    template <typename T>
-    Matrix(std::initializer_list<std::initializer_list<T>> list) {
-        int ind1 = 0;
-        for (auto sub_list : list) {
-            if (ind1 == M) {
-                break;
+    static void multiply(Value* first, const Value* second, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (vectorized) {
+            if (hasAvx2()) {
+                done = multiplyAvx2(first, second, count);
             }
-            int ind2 = 0;
-            for (T val : sub_list) {
-                if (ind2 == N) {
-                    break;
-                }
-                arr[ind1][ind2] = static_cast<Field>(val);
-                ++ind2;
-            }
-            ++ind1;
+        }
+#endif
+        for (size_t i = done; i < count; ++i) {
+            first[i] *= second[i];
         }
     }
 
-    std::array<Field, N>& operator[](int index) {
-        return arr[index];
+    static void axpy(Value* first, const Value& coeff, const Value* second, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (vectorized) {
+            if (hasAvx2()) {
+                done = axpyAvx2(first, coeff, second, count);
+            }
+        }
+#endif
+        for (size_t i = done; i < count; ++i) {
+            first[i] += coeff * second[i];
+        }
     }
 
-    const std::array<Field, N>& operator[](int index) const {
+    //lazy covers every vectorized modulus, the others have no kernel
+    static Value dot(const Value* first, const Value* second, size_t count) {
+        if constexpr (lazy) {
+            uint64_t sum = 0;
+            size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+            if (hasAvx2()) {
+                done = dotLazyAvx2(first, second, count, sum);
+            }
+#endif
+            for (size_t i = done; i < count; ++i) {
+                sum += static_cast<uint64_t>(first[i].x) * second[i].x;
+                sum -= sum >> 63 ? lazyLimit : 0;
+            }
+            return fold(sum);
+        }
+        else {
+            Value ans(0);
+            for (size_t i = 0; i < count; ++i) {
+                ans += first[i] * second[i];
+            }
+            return ans;
+        }
+    }
+
+    //sum of values[k] * vector[indices[k]], a row of a sparse matrix times a dense vector
+    static Value gatherDot(const Value* values, const size_t* indices, const Value* vector, size_t count) {
+        if constexpr (lazy) {
+            uint64_t sum = 0;
+            for (size_t k = 0; k < count; ++k) {
+                sum += static_cast<uint64_t>(values[k].x) * vector[indices[k]].x;
+                sum -= sum >> 63 ? lazyLimit : 0;
+            }
+            return fold(sum);
+        }
+        else {
+            Value ans(0);
+            for (size_t k = 0; k < count; ++k) {
+                ans += values[k] * vector[indices[k]];
+            }
+            return ans;
+        }
+    }
+
+    //the residue a lazily accumulated sum of raw products stands for
+    static Value fold(uint64_t sum) {
+        Value ans;
+        ans.x = Value::reduction.reduce(sum % (uint64_t(N) * N));
+        return ans;
+    }
+
+    //sums[i] += coeff * second[i] as raw products, for lazy moduli only
+    static void accumulate(uint64_t* sums, const Value& coeff, const Value* second, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (hasAvx2()) {
+            done = accumulateAvx2(sums, coeff, second, count);
+        }
+#endif
+        for (size_t i = done; i < count; ++i) {
+            sums[i] += static_cast<uint64_t>(coeff.x) * second[i].x;
+            sums[i] -= sums[i] >> 63 ? lazyLimit : 0;
+        }
+    }
+
+    //low[i], high[i] = low[i] + high[i], (low[i] - high[i]) * twiddles[i]
+    static void forwardButterfly(Value* low, Value* high, const Value* twiddles, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (vectorized) {
+            if (hasAvx2()) {
+                done = forwardButterflyAvx2(low, high, twiddles, count);
+            }
+        }
+#endif
+        for (size_t i = done; i < count; ++i) {
+            Value difference = low[i] - high[i];
+            low[i] += high[i];
+            high[i] = difference * twiddles[i];
+        }
+    }
+
+    //low[i], high[i] = low[i] + high[i] * twiddles[i], low[i] - high[i] * twiddles[i]
+    static void inverseButterfly(Value* low, Value* high, const Value* twiddles, size_t count) {
+        size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if constexpr (vectorized) {
+            if (hasAvx2()) {
+                done = inverseButterflyAvx2(low, high, twiddles, count);
+            }
+        }
+#endif
+        for (size_t i = done; i < count; ++i) {
+            Value product = high[i] * twiddles[i];
+            high[i] = low[i] - product;
+            low[i] += product;
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2"))) static __m256i load(const Value* pointer) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pointer->x));
+    }
+
+    __attribute__((target("avx2"))) static void store(Value* pointer, __m256i value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&pointer->x), value);
+    }
+
+    __attribute__((target("avx2"))) static size_t addAvx2(Value* first, const Value* second, size_t count) {
+        const __m256i mod = _mm256_set1_epi32(N);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            store(first + i, modularAdd8(load(first + i), load(second + i), mod));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t subtractAvx2(Value* first, const Value* second, size_t count) {
+        const __m256i mod = _mm256_set1_epi32(N);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            store(first + i, modularSubtract8(load(first + i), load(second + i), mod));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t multiplyAvx2(Value* first, const Value* second, size_t count) {
+        const __m256i mod = _mm256_set1_epi32(N);
+        const __m256i inverse = _mm256_set1_epi32(Value::reduction.inverse);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            store(first + i, montgomeryMultiply8(load(first + i), load(second + i), mod, inverse));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t axpyAvx2(Value* first, const Value& coeff, const Value* second, size_t count) {
+        const __m256i mod = _mm256_set1_epi32(N);
+        const __m256i inverse = _mm256_set1_epi32(Value::reduction.inverse);
+        const __m256i factor = _mm256_set1_epi32(coeff.x);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i product = montgomeryMultiply8(load(second + i), factor, mod, inverse);
+            store(first + i, modularAdd8(load(first + i), product, mod));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t forwardButterflyAvx2(Value* low, Value* high, const Value* twiddles,
+                                                                     size_t count) {
+        const __m256i mod = _mm256_set1_epi32(N);
+        const __m256i inverse = _mm256_set1_epi32(Value::reduction.inverse);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i first = load(low + i);
+            __m256i second = load(high + i);
+            store(low + i, modularAdd8(first, second, mod));
+            store(high + i, montgomeryMultiply8(modularSubtract8(first, second, mod), load(twiddles + i), mod, inverse));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t inverseButterflyAvx2(Value* low, Value* high, const Value* twiddles,
+                                                                     size_t count) {
+        const __m256i mod = _mm256_set1_epi32(N);
+        const __m256i inverse = _mm256_set1_epi32(Value::reduction.inverse);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i first = load(low + i);
+            __m256i product = montgomeryMultiply8(load(high + i), load(twiddles + i), mod, inverse);
+            store(low + i, modularAdd8(first, product, mod));
+            store(high + i, modularSubtract8(first, product, mod));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static __m256i widen(const Value* pointer) {
+        return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&pointer->x)));
+    }
+
+    //sum + product with lazyLimit taken off the lanes that reach 2^63
+    __attribute__((target("avx2"))) static __m256i lazyAdd4(__m256i sum, __m256i product, __m256i limit) {
+        sum = _mm256_add_epi64(sum, product);
+        return _mm256_sub_epi64(sum, _mm256_and_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), sum), limit));
+    }
+
+    __attribute__((target("avx2"))) static size_t accumulateAvx2(uint64_t* sums, const Value& coeff, const Value* second,
+                                                               size_t count) {
+        const __m256i factor = _mm256_set1_epi64x(coeff.x);
+        const __m256i limit = _mm256_set1_epi64x(lazyLimit);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i* low = reinterpret_cast<__m256i*>(sums + i);
+            __m256i* high = reinterpret_cast<__m256i*>(sums + i + 4);
+            __m256i low_product = _mm256_mul_epu32(widen(second + i), factor);
+            __m256i high_product = _mm256_mul_epu32(widen(second + i + 4), factor);
+            _mm256_storeu_si256(low, lazyAdd4(_mm256_loadu_si256(low), low_product, limit));
+            _mm256_storeu_si256(high, lazyAdd4(_mm256_loadu_si256(high), high_product, limit));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static size_t dotLazyAvx2(const Value* first, const Value* second, size_t count,
+                                                            uint64_t& sum) {
+        const __m256i limit = _mm256_set1_epi64x(lazyLimit);
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            low = lazyAdd4(low, _mm256_mul_epu32(widen(first + i), widen(second + i)), limit);
+            high = lazyAdd4(high, _mm256_mul_epu32(widen(first + i + 4), widen(second + i + 4)), limit);
+        }
+        alignas(32) uint64_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), low);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 4), high);
+        //a lane may be close to 2^63, one subtraction of lazyLimit would not bring the sum back under it
+        for (uint64_t lane : lanes) {
+            sum += lane % (uint64_t(N) * N);
+            sum -= sum >> 63 ? lazyLimit : 0;
+        }
+        return i;
+    }
+#endif
+};
+
+template <size_t N>
+void addInPlace(std::span<Residue<N>> first, std::span<const Residue<N>> second) {
+    ResidueKernels<N>::add(first.data(), second.data(), std::min(first.size(), second.size()));
+}
+
+template <size_t N>
+void subtractInPlace(std::span<Residue<N>> first, std::span<const Residue<N>> second) {
+    ResidueKernels<N>::subtract(first.data(), second.data(), std::min(first.size(), second.size()));
+}
+
+template <size_t N>
+void multiplyInPlace(std::span<Residue<N>> first, std::span<const Residue<N>> second) {
+    ResidueKernels<N>::multiply(first.data(), second.data(), std::min(first.size(), second.size()));
+}
+
+//first[i] += coeff * second[i]
+template <size_t N>
+void axpy(std::span<Residue<N>> first, const Residue<N>& coeff, std::span<const Residue<N>> second) {
+    ResidueKernels<N>::axpy(first.data(), coeff, second.data(), std::min(first.size(), second.size()));
+}
+
+template <size_t N>
+Residue<N> dot(std::span<const Residue<N>> first, std::span<const Residue<N>> second) {
+    return ResidueKernels<N>::dot(first.data(), second.data(), std::min(first.size(), second.size()));
+}
+
+//customization point for what the matrix algorithms ask of a Field: the defaults go through the operators,
+//a specialization may answer without building Field(0) or a product temporary
+template <typename Field>
+struct FieldTraits {
+    static inline const Field zero = Field(0);
+
+    static bool is_zero(const Field& value) {
+        return value == zero;
+    }
+
+    static bool is_one(const Field& value) {
+        return value == Field(1);
+    }
+
+    //a -= b * c
+    static void fms(Field& a, const Field& b, const Field& c) {
+        a -= b * c;
+    }
+
+    //a += b * c
+    static void fma(Field& a, const Field& b, const Field& c) {
+        a += b * c;
+    }
+
+    static void negate_inplace(Field& value) {
+        value = -value;
+    }
+};
+
+template <>
+struct FieldTraits<Rational> {
+    static inline const Rational zero = Rational(0);
+
+    static bool is_zero(const Rational& value) {
+        return value.isZero();
+    }
+
+    static bool is_one(const Rational& value) {
+        return value == Rational(1);
+    }
+
+    static void fms(Rational& a, const Rational& b, const Rational& c) {
+        a.subtractProduct(b, c);
+    }
+
+    static void fma(Rational& a, const Rational& b, const Rational& c) {
+        a.addProduct(b, c);
+    }
+
+    static void negate_inplace(Rational& value) {
+        value.negate();
+    }
+};
+
+template <>
+struct FieldTraits<BigInteger> {
+    static inline const BigInteger zero = BigInteger();
+
+    static bool is_zero(const BigInteger& value) {
+        return !value;
+    }
+
+    static bool is_one(const BigInteger& value) {
+        return value == BigInteger(1);
+    }
+
+    static void fms(BigInteger& a, const BigInteger& b, const BigInteger& c) {
+        if (b && c) {
+            a -= b * c;
+        }
+    }
+
+    static void fma(BigInteger& a, const BigInteger& b, const BigInteger& c) {
+        if (b && c) {
+            a += b * c;
+        }
+    }
+
+    static void negate_inplace(BigInteger& value) {
+        if (value) {
+            value.ChangeSign();
+        }
+    }
+};
+
+//row[i] -= source[i] * coeff, the row update of the elimination loops
+template <typename Field>
+void subtractMultiple(Field* row, const Field* source, const Field& coeff, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        FieldTraits<Field>::fms(row[i], source[i], coeff);
+    }
+}
+
+template <size_t N>
+void subtractMultiple(Residue<N>* row, const Residue<N>* source, const Residue<N>& coeff, size_t count) {
+    ResidueKernels<N>::axpy(row, -coeff, source, count);
+}
+
+//sum of first[k] * second[k]
+template <typename Field>
+Field dot_product(const Field* first, const Field* second, size_t count) {
+    Field ans = FieldTraits<Field>::zero;
+    for (size_t k = 0; k < count; ++k) {
+        FieldTraits<Field>::fma(ans, first[k], second[k]);
+    }
+    return ans;
+}
+
+template <size_t N>
+Residue<N> dot_product(const Residue<N>* first, const Residue<N>* second, size_t count) {
+    return ResidueKernels<N>::dot(first, second, count);
+}
+
+//sum of values[k] * vector[indices[k]]
+template <typename Field>
+Field gather_dot(const Field* values, const size_t* indices, const Field* vector, size_t count) {
+    Field ans = FieldTraits<Field>::zero;
+    for (size_t k = 0; k < count; ++k) {
+        FieldTraits<Field>::fma(ans, values[k], vector[indices[k]]);
+    }
+    return ans;
+}
+
+template <size_t N>
+Residue<N> gather_dot(const Residue<N>* values, const size_t* indices, const Residue<N>* vector, size_t count) {
+    return ResidueKernels<N>::gatherDot(values, indices, vector, count);
+}
+
+//runtime counterpart of ResidueReduction<N>: the same three strategies, picked once per modulus
+struct DynamicReduction {
+    using value_type = uint64_t;
+
+    enum class Kind { montgomery32, barrett32, montgomery64, remainder };
+
+    uint64_t mod;
+    Kind kind;
+    MontgomeryReduction32 montgomery32;
+    BarrettReduction32 barrett32;
+    MontgomeryReduction64 montgomery64;
+    RemainderReduction64 remainder;
+
+    static Kind kindFor(uint64_t mod) {
+        if (mod < (uint64_t(1) << 31)) {
+            return mod % 2 == 1 ? Kind::montgomery32 : Kind::barrett32;
+        }
+        return mod % 2 == 1 ? Kind::montgomery64 : Kind::remainder;
+    }
+
+    explicit DynamicReduction(uint64_t mod) : mod(mod), kind(kindFor(mod)), montgomery32(kind == Kind::montgomery32 ? mod : 1),
+        barrett32(kind == Kind::barrett32 ? mod : 2), montgomery64(kind == Kind::montgomery64 ? mod : 1), remainder(mod) {}
+
+    uint64_t multiply(uint64_t a, uint64_t b) const {
+        if (kind == Kind::montgomery32) {
+            return montgomery32.multiply(a, b);
+        }
+        if (kind == Kind::barrett32) {
+            return barrett32.multiply(a, b);
+        }
+        return kind == Kind::montgomery64 ? montgomery64.multiply(a, b) : remainder.multiply(a, b);
+    }
+
+    uint64_t subtract(uint64_t a, uint64_t b) const {
+        return a - b + (a < b ? mod : 0);
+    }
+
+    uint64_t add(uint64_t a, uint64_t b) const {
+        return subtract(a, mod - b);
+    }
+
+    uint64_t transform(uint64_t value) const {
+        if (kind == Kind::montgomery32) {
+            return montgomery32.transform(value);
+        }
+        return kind == Kind::montgomery64 ? montgomery64.transform(value) : value;
+    }
+
+    uint64_t restore(uint64_t value) const {
+        if (kind == Kind::montgomery32) {
+            return montgomery32.restore(value);
+        }
+        return kind == Kind::montgomery64 ? montgomery64.restore(value) : value;
+    }
+};
+
+//Residue with a modulus chosen at runtime; every Id has its own modulus, and values created
+//before a setModulus() call must not be used after it
+template <int Id = 0>
+class DynamicResidue {
+private:
+    static inline DynamicReduction reduction = DynamicReduction(1);
+
+    uint64_t x;
+
+    static uint64_t normalize(long long value) {
+        if (value >= 0) {
+            return static_cast<uint64_t>(value) % reduction.mod;
+        }
+        return reduction.mod - 1 - static_cast<uint64_t>(-(value + 1)) % reduction.mod;
+    }
+public:
+    static void setModulus(uint64_t mod) {
+        if (mod == 0) {
+            throw std::invalid_argument("the modulus must be positive");
+        }
+        reduction = DynamicReduction(mod);
+    }
+
+    static uint64_t modulus() {
+        return reduction.mod;
+    }
+
+    DynamicResidue() = default;
+
+    explicit DynamicResidue(long long x) : x(reduction.transform(normalize(x))) {}
+
+    DynamicResidue operator-() const {
+        DynamicResidue copy;
+        copy.x = reduction.subtract(0, x);
+        return copy;
+    }
+
+    DynamicResidue& operator+=(const DynamicResidue& other) {
+        x = reduction.add(x, other.x);
+        return *this;
+    }
+
+    DynamicResidue& operator-=(const DynamicResidue& other) {
+        x = reduction.subtract(x, other.x);
+        return *this;
+    }
+
+    DynamicResidue& operator*=(const DynamicResidue& other) {
+        x = reduction.multiply(x, other.x);
+        return *this;
+    }
+
+    DynamicResidue& operator/=(const DynamicResidue& other) {
+        return (*this) *= other.inverse();
+    }
+
+    DynamicResidue inverse() const {
+        DynamicResidue ans;
+        ans.x = reduction.transform(inverse_mod<uint64_t>(reduction.restore(x), reduction.mod));
+        return ans;
+    }
+
+    bool operator==(const DynamicResidue& other) const { return x == other.x; }
+
+    bool operator!=(const DynamicResidue& other) const { return x != other.x; }
+
+    explicit operator int() const {
+        return reduction.restore(x);
+    }
+
+    explicit operator long long() const {
+        return reduction.restore(x);
+    }
+
+    explicit operator unsigned long long() const {
+        return reduction.restore(x);
+    }
+};
+
+template <int Id>
+DynamicResidue<Id> pown(const DynamicResidue<Id>& n, unsigned long long k) {
+    DynamicResidue<Id> ans(1);
+    DynamicResidue<Id> val = n;
+    while (k > 0) {
+        if (k % 2 == 1) {
+            ans *= val;
+        }
+        val *= val;
+        k /= 2;
+    }
+    return ans;
+}
+
+template <int Id>
+DynamicResidue<Id> operator+(const DynamicResidue<Id>& first, const DynamicResidue<Id>& second) {
+    DynamicResidue<Id> copy = first;
+    copy += second;
+    return copy;
+}
+
+template <int Id>
+DynamicResidue<Id> operator-(const DynamicResidue<Id>& first, const DynamicResidue<Id>& second) {
+    DynamicResidue<Id> copy = first;
+    copy -= second;
+    return copy;
+}
+
+template <int Id>
+DynamicResidue<Id> operator*(const DynamicResidue<Id>& first, const DynamicResidue<Id>& second) {
+    DynamicResidue<Id> copy = first;
+    copy *= second;
+    return copy;
+}
+
+template <int Id>
+DynamicResidue<Id> operator/(const DynamicResidue<Id>& first, const DynamicResidue<Id>& second) {
+    DynamicResidue<Id> copy = first;
+    copy /= second;
+    return copy;
+}
+
+template <int Id>
+std::ostream& operator<<(std::ostream& out, DynamicResidue<Id> num) {
+    out << static_cast<unsigned long long>(num);
+    return out;
+}
+
+//finds n / d == value mod modulus with |n|, d <= sqrt(modulus / 2) by the half-extended Euclid algorithm,
+//such a fraction is unique when it exists
+bool rational_reconstruction(const BigInteger& value, const BigInteger& modulus, Rational& result) {
+    BigInteger previous_remainder = modulus;
+    BigInteger remainder = value % modulus;
+    if (remainder.IsNegative()) {
+        remainder += modulus;
+    }
+    BigInteger previous_coeff = 0;
+    BigInteger coeff = 1;
+    BigInteger quotient;
+    //limb counts settle the comparison with the bound except near it
+    auto above_bound = [&modulus](const BigInteger& number) {
+        if (2 * number.length() + 2 <= modulus.length()) {
+            return false;
+        }
+        if (2 * number.length() >= modulus.length() + 2) {
+            return true;
+        }
+        return number * number * 2 > modulus;
+    };
+    while (above_bound(remainder)) {
+        euclidStep(previous_remainder, remainder, quotient);
+        BigInteger next_coeff = previous_coeff - quotient * coeff;
+        previous_coeff.swap(coeff);
+        coeff.swap(next_coeff);
+    }
+    if (above_bound(coeff) || gcd(remainder, coeff) != 1) {
+        return false;
+    }
+    result = Rational(remainder, coeff);
+    return true;
+}
+
+//Chinese remaindering over a fixed list of distinct primes below 2^63; the products of all ranges of primes
+//are kept in a tree, so combining residues costs one pass up the tree and a single division
+class ChineseRemainder {
+private:
+    std::vector<uint64_t> primes;
+    std::vector<uint64_t> weights;
+    std::vector<BigInteger> tree;
+    BigInteger halfModulus;
+
+    void buildTree(size_t node, size_t left, size_t right) {
+        if (right - left == 1) {
+            tree[node] = BigInteger(static_cast<long long>(primes[left]));
+            return;
+        }
+        size_t middle = (left + right) / 2;
+        buildTree(2 * node, left, middle);
+        buildTree(2 * node + 1, middle, right);
+        tree[node] = tree[2 * node] * tree[2 * node + 1];
+    }
+
+    //sum of residue_i * weight_i * (product of the range / p_i) over the range
+    BigInteger combineOnTree(size_t node, size_t left, size_t right, std::span<const uint64_t> residues) const {
+        if (right - left == 1) {
+            uint64_t prime = primes[left];
+            return BigInteger(static_cast<long long>(multiply_mod(residues[left] % prime, weights[left], prime)));
+        }
+        size_t middle = (left + right) / 2;
+        BigInteger ans = combineOnTree(2 * node, left, middle, residues) * tree[2 * node + 1];
+        ans += combineOnTree(2 * node + 1, middle, right, residues) * tree[2 * node];
+        return ans;
+    }
+public:
+    explicit ChineseRemainder(std::vector<uint64_t> primes) : primes(std::move(primes)) {
+        size_t count = this->primes.size();
+        if (count == 0) {
+            throw std::invalid_argument("the list of primes is empty");
+        }
+        for (uint64_t prime : this->primes) {
+            if (prime < 2 || prime > LLONG_MAX) {
+                throw std::invalid_argument("the primes must lie in [2, 2^63)");
+            }
+        }
+        //weight_i is the inverse of M / p_i modulo p_i
+        weights.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t prime = this->primes[i];
+            uint64_t cofactor = 1;
+            for (size_t j = 0; j < count; ++j) {
+                if (j != i) {
+                    cofactor = multiply_mod(cofactor, this->primes[j] % prime, prime);
+                }
+            }
+            weights[i] = inverse_mod<uint64_t>(cofactor, prime);
+            if (weights[i] == 0) {
+                throw std::invalid_argument("the primes must be distinct");
+            }
+        }
+        tree.resize(4 * count);
+        buildTree(1, 0, count);
+        halfModulus = tree[1] / 2;
+    }
+
+    size_t size() const {
+        return primes.size();
+    }
+
+    const BigInteger& modulus() const {
+        return tree[1];
+    }
+
+    //the representative in (-M / 2, M / 2]
+    BigInteger combine(std::span<const uint64_t> residues) const {
+        if (residues.size() != primes.size()) {
+            throw std::invalid_argument("vectors of different sizes");
+        }
+        BigInteger ans = combineOnTree(1, 0, primes.size(), residues) % tree[1];
+        if (ans > halfModulus) {
+            ans -= tree[1];
+        }
+        return ans;
+    }
+
+    bool reconstructRational(std::span<const uint64_t> residues, Rational& result) const {
+        return rational_reconstruction(combine(residues), tree[1], result);
+    }
+};
+
+//the same reconstruction one prime at a time (Garner's scheme), for when the number of primes is not known
+//in advance: the integer is final once `extra` more primes left it unchanged, and the fraction once `extra`
+//more primes agreed with the last successful rational reconstruction; failed reconstructions are retried only
+//after the number of primes grows by a quarter, so a long run makes O(log) attempts
+class IncrementalChineseRemainder {
+private:
+    BigInteger current;
+    BigInteger product = 1;
+    size_t count = 0;
+    size_t unchanged = 0;
+    size_t nextAttempt = 1;
+    bool trackRational;
+    bool hasCandidate = false;
+    Rational candidate;
+    BigInteger candidateNumerator;
+    BigInteger candidateDenominator;
+    size_t agreements = 0;
+public:
+    //rational reconstruction is only attempted when asked for
+    explicit IncrementalChineseRemainder(bool rational = false) : trackRational(rational) {}
+
+    void add(uint64_t prime, uint64_t residue) {
+        if (prime < 2 || prime > LLONG_MAX) {
+            throw std::invalid_argument("the primes must lie in [2, 2^63)");
+        }
+        uint64_t factor = inverse_mod<uint64_t>(product.residue(prime), prime);
+        if (factor == 0) {
+            throw std::invalid_argument("the primes must be distinct");
+        }
+        residue %= prime;
+        //current stays in (-M / 2, M / 2], so an unchanged value means a zero step
+        uint64_t step = multiply_mod((residue + prime - current.residue(prime)) % prime, factor, prime);
+        if (step == 0) {
+            ++unchanged;
+        }
+        else {
+            unchanged = 0;
+            long long signed_step = step > prime / 2 ? -static_cast<long long>(prime - step) : static_cast<long long>(step);
+            //modulo 2 both signs are the same step, the one towards zero keeps the range
+            if (prime == 2 && current && !current.IsNegative()) {
+                signed_step = -1;
+            }
+            current += product * BigInteger(signed_step);
+        }
+        product *= BigInteger(static_cast<long long>(prime));
+        ++count;
+        if (!trackRational) {
+            return;
+        }
+        if (hasCandidate && candidateNumerator.residue(prime) == multiply_mod(candidateDenominator.residue(prime), residue, prime)) {
+            ++agreements;
+            return;
+        }
+        agreements = 0;
+        hasCandidate = false;
+        if (count < nextAttempt) {
+            return;
+        }
+        nextAttempt = count + std::max<size_t>(1, count / 4);
+        hasCandidate = rational_reconstruction(current, product, candidate);
+        if (hasCandidate) {
+            candidateNumerator = candidate.getNumerator();
+            candidateDenominator = candidate.getDenominator();
+        }
+    }
+
+    const BigInteger& modulus() const {
+        return product;
+    }
+
+    //the representative in (-M / 2, M / 2]
+    const BigInteger& integer() const {
+        return current;
+    }
+
+    bool integerStable(size_t extra) const {
+        return unchanged >= extra;
+    }
+
+    bool hasRational() const {
+        return hasCandidate;
+    }
+
+    //meaningful only when hasRational()
+    const Rational& rational() const {
+        return candidate;
+    }
+
+    bool rationalStable(size_t extra) const {
+        return hasCandidate && agreements >= extra;
+    }
+};
+
+//row[i] += source[i] * coeff, the row update of the multiplication kernels
+template <typename Field>
+void addMultiple(Field* row, const Field* source, const Field& coeff, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        FieldTraits<Field>::fma(row[i], source[i], coeff);
+    }
+}
+
+template <size_t N>
+void addMultiple(Residue<N>* row, const Residue<N>* source, const Residue<N>& coeff, size_t count) {
+    ResidueKernels<N>::axpy(row, coeff, source, count);
+}
+
+//tile sizes of the multiplication: a packed inner x columns panel of the right operand stays in L2,
+//double tiles of the result are computed in registers by 4 x 8 micro-kernels
+template <typename Field>
+struct MultiplyTiles {
+    static constexpr size_t inner = std::clamp<size_t>(2048 / sizeof(Field), 16, 256);
+    static constexpr size_t columns = std::clamp<size_t>((size_t(1) << 18) / (sizeof(Field) * inner), 16, 1024) / 8 * 8;
+    static constexpr size_t rows = 64;
+    static constexpr size_t microRows = 4;
+    static constexpr size_t microColumns = 8;
+};
+
+//acc += a * b for a packed microRows x depth block a and a depth x microColumns block b
+inline void multiply_micro_kernel(const double* a, const double* b, size_t depth, double* acc) {
+    for (size_t k = 0; k < depth; ++k) {
+        for (size_t r = 0; r < 4; ++r) {
+            for (size_t c = 0; c < 8; ++c) {
+                acc[r * 8 + c] += a[k * 4 + r] * b[k * 8 + c];
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma"))) inline void multiply_micro_kernel_avx2(const double* a, const double* b, size_t depth, double* acc) {
+    __m256d c00 = _mm256_loadu_pd(acc), c01 = _mm256_loadu_pd(acc + 4);
+    __m256d c10 = _mm256_loadu_pd(acc + 8), c11 = _mm256_loadu_pd(acc + 12);
+    __m256d c20 = _mm256_loadu_pd(acc + 16), c21 = _mm256_loadu_pd(acc + 20);
+    __m256d c30 = _mm256_loadu_pd(acc + 24), c31 = _mm256_loadu_pd(acc + 28);
+    for (size_t k = 0; k < depth; ++k) {
+        __m256d b0 = _mm256_loadu_pd(b + k * 8);
+        __m256d b1 = _mm256_loadu_pd(b + k * 8 + 4);
+        __m256d a0 = _mm256_broadcast_sd(a + k * 4);
+        c00 = _mm256_fmadd_pd(a0, b0, c00);
+        c01 = _mm256_fmadd_pd(a0, b1, c01);
+        __m256d a1 = _mm256_broadcast_sd(a + k * 4 + 1);
+        c10 = _mm256_fmadd_pd(a1, b0, c10);
+        c11 = _mm256_fmadd_pd(a1, b1, c11);
+        __m256d a2 = _mm256_broadcast_sd(a + k * 4 + 2);
+        c20 = _mm256_fmadd_pd(a2, b0, c20);
+        c21 = _mm256_fmadd_pd(a2, b1, c21);
+        __m256d a3 = _mm256_broadcast_sd(a + k * 4 + 3);
+        c30 = _mm256_fmadd_pd(a3, b0, c30);
+        c31 = _mm256_fmadd_pd(a3, b1, c31);
+    }
+    _mm256_storeu_pd(acc, c00);
+    _mm256_storeu_pd(acc + 4, c01);
+    _mm256_storeu_pd(acc + 8, c10);
+    _mm256_storeu_pd(acc + 12, c11);
+    _mm256_storeu_pd(acc + 16, c20);
+    _mm256_storeu_pd(acc + 20, c21);
+    _mm256_storeu_pd(acc + 24, c30);
+    _mm256_storeu_pd(acc + 28, c31);
+}
+
+inline bool hasAvx2Fma() {
+    static const bool ans = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return ans;
+}
+#else
+inline bool hasAvx2Fma() {
+    return false;
+}
+#endif
+
+//per-thread scratch that only grows, so repeated products do not allocate; Slot tells apart two buffers
+//of one type that are used at the same time
+template <typename T, int Slot = 0>
+T* scratch_buffer(size_t size) {
+    thread_local std::vector<T> buffer;
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+    return buffer.data();
+}
+
+//ans += first * second for row-major blocks given by a pointer and a row stride
+template <typename Field>
+void multiply_add(const Field* first, size_t first_stride, const Field* second, size_t second_stride,
+                  Field* ans, size_t ans_stride, size_t rows, size_t inner, size_t columns) {
+    //copying heavy fields costs more than the cache misses it saves, they go row by row unpacked
+    if constexpr (!std::is_trivially_copyable_v<Field>) {
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t k = 0; k < inner; ++k) {
+                const Field& coeff = first[i * first_stride + k];
+                if (!FieldTraits<Field>::is_zero(coeff)) {
+                    addMultiple(ans + i * ans_stride, second + k * second_stride, coeff, columns);
+                }
+            }
+        }
+        return;
+    }
+    using Tiles = MultiplyTiles<Field>;
+    Field* panel = scratch_buffer<Field>(std::min(inner, Tiles::inner) * std::min(columns, Tiles::columns));
+    for (size_t jj = 0; jj < columns; jj += Tiles::columns) {
+        size_t width = std::min(Tiles::columns, columns - jj);
+        for (size_t kk = 0; kk < inner; kk += Tiles::inner) {
+            size_t depth = std::min(Tiles::inner, inner - kk);
+            for (size_t k = 0; k < depth; ++k) {
+                std::copy(second + (kk + k) * second_stride + jj, second + (kk + k) * second_stride + jj + width,
+                          panel + k * width);
+            }
+            for (size_t i = 0; i < rows; ++i) {
+                Field* row = ans + i * ans_stride + jj;
+                for (size_t k = 0; k < depth; ++k) {
+                    const Field& coeff = first[i * first_stride + kk + k];
+                    if (!FieldTraits<Field>::is_zero(coeff)) {
+                        addMultiple(row, panel + k * width, coeff, width);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//double blocks are packed into microRows- and microColumns-wide strips padded with zeros,
+//so every micro-kernel call runs over full registers
+template <>
+inline void multiply_add<double>(const double* first, size_t first_stride, const double* second, size_t second_stride,
+                                 double* ans, size_t ans_stride, size_t rows, size_t inner, size_t columns) {
+    using Tiles = MultiplyTiles<double>;
+    const size_t mr = Tiles::microRows;
+    const size_t nr = Tiles::microColumns;
+    auto round_up = [](size_t value, size_t step) { return (value + step - 1) / step * step; };
+    double* packed_second = scratch_buffer<double, 0>(std::min(inner, Tiles::inner) * round_up(std::min(columns, Tiles::columns), nr));
+    double* packed_first = scratch_buffer<double, 1>(std::min(inner, Tiles::inner) * round_up(std::min(rows, Tiles::rows), mr));
+    bool vectorized = hasAvx2Fma();
+    for (size_t jj = 0; jj < columns; jj += Tiles::columns) {
+        size_t width = std::min(Tiles::columns, columns - jj);
+        for (size_t kk = 0; kk < inner; kk += Tiles::inner) {
+            size_t depth = std::min(Tiles::inner, inner - kk);
+            for (size_t strip = 0; strip < width; strip += nr) {
+                double* out = packed_second + strip * depth;
+                for (size_t k = 0; k < depth; ++k) {
+                    for (size_t c = 0; c < nr; ++c) {
+                        out[k * nr + c] = strip + c < width ? second[(kk + k) * second_stride + jj + strip + c] : 0;
+                    }
+                }
+            }
+            for (size_t ii = 0; ii < rows; ii += Tiles::rows) {
+                size_t height = std::min(Tiles::rows, rows - ii);
+                for (size_t strip = 0; strip < height; strip += mr) {
+                    double* out = packed_first + strip * depth;
+                    for (size_t k = 0; k < depth; ++k) {
+                        for (size_t r = 0; r < mr; ++r) {
+                            out[k * mr + r] = strip + r < height ? first[(ii + strip + r) * first_stride + kk + k] : 0;
+                        }
+                    }
+                }
+                for (size_t i = 0; i < height; i += mr) {
+                    for (size_t j = 0; j < width; j += nr) {
+                        double acc[4 * 8] = {};
+#if defined(__x86_64__) || defined(__i386__)
+                        if (vectorized) {
+                            multiply_micro_kernel_avx2(packed_first + i * depth, packed_second + j * depth, depth, acc);
+                        }
+                        else {
+                            multiply_micro_kernel(packed_first + i * depth, packed_second + j * depth, depth, acc);
+                        }
+#else
+                        multiply_micro_kernel(packed_first + i * depth, packed_second + j * depth, depth, acc);
+#endif
+                        for (size_t r = 0; r < mr && i + r < height; ++r) {
+                            double* row = ans + (ii + i + r) * ans_stride + jj + j;
+                            for (size_t c = 0; c < nr && j + c < width; ++c) {
+                                row[c] += acc[r * nr + c];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//Residue blocks below 2^31 sum the raw products of a row over a whole panel in 64 bits and reduce each entry once
+template <size_t N>
+void multiply_add(const Residue<N>* first, size_t first_stride, const Residue<N>* second, size_t second_stride,
+                  Residue<N>* ans, size_t ans_stride, size_t rows, size_t inner, size_t columns) {
+    using Kernels = ResidueKernels<N>;
+    if constexpr (!Kernels::lazy) {
+        multiply_add<Residue<N>>(first, first_stride, second, second_stride, ans, ans_stride, rows, inner, columns);
+    }
+    else {
+        using Tiles = MultiplyTiles<Residue<N>>;
+        Residue<N>* panel = scratch_buffer<Residue<N>>(std::min(inner, Tiles::inner) * std::min(columns, Tiles::columns));
+        uint64_t* sums = scratch_buffer<uint64_t>(std::min(columns, Tiles::columns));
+        for (size_t jj = 0; jj < columns; jj += Tiles::columns) {
+            size_t width = std::min(Tiles::columns, columns - jj);
+            for (size_t kk = 0; kk < inner; kk += Tiles::inner) {
+                size_t depth = std::min(Tiles::inner, inner - kk);
+                for (size_t k = 0; k < depth; ++k) {
+                    std::copy(second + (kk + k) * second_stride + jj, second + (kk + k) * second_stride + jj + width,
+                              panel + k * width);
+                }
+                for (size_t i = 0; i < rows; ++i) {
+                    std::fill(sums, sums + width, 0);
+                    for (size_t k = 0; k < depth; ++k) {
+                        const Residue<N>& coeff = first[i * first_stride + kk + k];
+                        if (!FieldTraits<Residue<N>>::is_zero(coeff)) {
+                            Kernels::accumulate(sums, coeff, panel + k * width, width);
+                        }
+                    }
+                    Residue<N>* row = ans + i * ans_stride + jj;
+                    for (size_t j = 0; j < width; ++j) {
+                        row[j] += Kernels::fold(sums[j]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//the size below which Strassen-Winograd hands blocks to the classical kernel
+template <typename Field>
+struct StrassenThreshold {
+    static constexpr size_t value = 128;
+};
+
+template <size_t N>
+struct StrassenThreshold<Residue<N>> {
+    static constexpr size_t value = 256;
+};
+
+template <typename Field>
+void block_add(Field* ans, size_t ans_stride, const Field* first, size_t first_stride,
+               const Field* second, size_t second_stride, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = 0; j < size; ++j) {
+            ans[i * ans_stride + j] = first[i * first_stride + j] + second[i * second_stride + j];
+        }
+    }
+}
+
+template <typename Field>
+void block_subtract(Field* ans, size_t ans_stride, const Field* first, size_t first_stride,
+                    const Field* second, size_t second_stride, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = 0; j < size; ++j) {
+            ans[i * ans_stride + j] = first[i * first_stride + j] - second[i * second_stride + j];
+        }
+    }
+}
+
+//two half-size temporaries per level, odd sizes peel the last row and column
+template <typename Field>
+size_t strassen_workspace_size(size_t size) {
+    if (size <= StrassenThreshold<Field>::value) {
+        return 0;
+    }
+    if (size % 2 == 1) {
+        return strassen_workspace_size<Field>(size - 1);
+    }
+    return 2 * (size / 2) * (size / 2) + strassen_workspace_size<Field>(size / 2);
+}
+
+//ans = first * second for square blocks, with the Strassen-Winograd schedule of Boyer, Dumas, Pernet and Zhou:
+//7 half-size products and 15 additions using only the quadrants of ans and two temporaries
+template <typename Field>
+void strassen_multiply(const Field* first, size_t first_stride, const Field* second, size_t second_stride,
+                       Field* ans, size_t ans_stride, size_t size, Field* workspace) {
+    if (size <= StrassenThreshold<Field>::value) {
+        for (size_t i = 0; i < size; ++i) {
+            std::fill(ans + i * ans_stride, ans + i * ans_stride + size, FieldTraits<Field>::zero);
+        }
+        multiply_add(first, first_stride, second, second_stride, ans, ans_stride, size, size, size);
+        return;
+    }
+    if (size % 2 == 1) {
+        size_t even = size - 1;
+        strassen_multiply(first, first_stride, second, second_stride, ans, ans_stride, even, workspace);
+        for (size_t i = 0; i < size; ++i) {
+            ans[i * ans_stride + even] = FieldTraits<Field>::zero;
+        }
+        std::fill(ans + even * ans_stride, ans + even * ans_stride + even, FieldTraits<Field>::zero);
+        multiply_add(first + even, first_stride, second + even * second_stride, second_stride, ans, ans_stride, even, 1, even);
+        multiply_add(first, first_stride, second + even, second_stride, ans + even, ans_stride, even, size, 1);
+        multiply_add(first + even * first_stride, first_stride, second, second_stride, ans + even * ans_stride, ans_stride, 1, size, size);
+        return;
+    }
+    size_t half = size / 2;
+    const Field* a11 = first;
+    const Field* a12 = first + half;
+    const Field* a21 = first + half * first_stride;
+    const Field* a22 = a21 + half;
+    const Field* b11 = second;
+    const Field* b12 = second + half;
+    const Field* b21 = second + half * second_stride;
+    const Field* b22 = b21 + half;
+    Field* c11 = ans;
+    Field* c12 = ans + half;
+    Field* c21 = ans + half * ans_stride;
+    Field* c22 = c21 + half;
+    Field* x = workspace;
+    Field* y = x + half * half;
+    Field* rest = y + half * half;
+    block_subtract(x, half, a11, first_stride, a21, first_stride, half);
+    block_subtract(y, half, b22, second_stride, b12, second_stride, half);
+    strassen_multiply(x, half, y, half, c21, ans_stride, half, rest);
+    block_add(x, half, a21, first_stride, a22, first_stride, half);
+    block_subtract(y, half, b12, second_stride, b11, second_stride, half);
+    strassen_multiply(x, half, y, half, c22, ans_stride, half, rest);
+    block_subtract(x, half, x, half, a11, first_stride, half);
+    block_subtract(y, half, b22, second_stride, y, half, half);
+    strassen_multiply(x, half, y, half, c12, ans_stride, half, rest);
+    block_subtract(x, half, a12, first_stride, x, half, half);
+    strassen_multiply(x, half, b22, second_stride, c11, ans_stride, half, rest);
+    strassen_multiply(a11, first_stride, b11, second_stride, x, half, half, rest);
+    block_add(c12, ans_stride, x, half, c12, ans_stride, half);
+    block_add(c21, ans_stride, c12, ans_stride, c21, ans_stride, half);
+    block_add(c12, ans_stride, c12, ans_stride, c22, ans_stride, half);
+    block_add(c22, ans_stride, c21, ans_stride, c22, ans_stride, half);
+    block_add(c12, ans_stride, c12, ans_stride, c11, ans_stride, half);
+    block_subtract(y, half, y, half, b21, second_stride, half);
+    strassen_multiply(a22, first_stride, y, half, c11, ans_stride, half, rest);
+    block_subtract(c21, ans_stride, c21, ans_stride, c11, ans_stride, half);
+    strassen_multiply(a12, first_stride, b21, second_stride, c11, ans_stride, half, rest);
+    block_add(c11, ans_stride, x, half, c11, ans_stride, half);
+}
+
+//a fixed set of hardware_concurrency() - 1 workers; run() hands task indices out to them and to the calling thread
+//and returns once all are done, calls from inside a task or while another run() is in flight go serially. The first
+//exception a task throws skips the indices not started yet and is rethrown by run() after every worker has stopped
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex runMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* task = nullptr;
+    size_t taskCount = 0;
+    std::atomic<size_t> nextTask = 0;
+    size_t generation = 0;
+    size_t busy = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    static inline thread_local bool insideTask = false;
+
+    void work(size_t count) {
+        bool previous = insideTask;
+        insideTask = true;
+        try {
+            for (size_t index = nextTask++; index < count; index = nextTask++) {
+                (*task)(index);
+            }
+        }
+        catch (...) {
+            std::lock_guard lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            nextTask = count;
+        }
+        insideTask = previous;
+    }
+
+    void loop() {
+        size_t seen = 0;
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            size_t count = taskCount;
+            lock.unlock();
+            work(count);
+            lock.lock();
+            if (--busy == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+public:
+    explicit ThreadPool(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { loop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    static ThreadPool& instance() {
+        static ThreadPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 1) - 1);
+        return pool;
+    }
+
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    void run(size_t count, const std::function<void(size_t)>& function) {
+        std::unique_lock run_lock(runMutex, std::try_to_lock);
+        if (insideTask || !run_lock.owns_lock() || workers.empty() || count < 2) {
+            for (size_t i = 0; i < count; ++i) {
+                function(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard lock(mutex);
+            task = &function;
+            taskCount = count;
+            nextTask = 0;
+            busy = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        work(count);
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&] { return busy == 0; });
+        task = nullptr;
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+};
+
+//function(begin, end) over chunks of [0, count) on the thread pool, serially unless count * cost is large enough
+//to pay for the hand-off
+template <typename Function>
+void parallel_for(size_t count, size_t cost, Function function) {
+    ThreadPool& pool = ThreadPool::instance();
+    size_t chunks = std::min(count, pool.size() * 4);
+    if (chunks < 2 || pool.size() == 1 || count * cost < (1 << 16)) {
+        function(0, count);
+        return;
+    }
+    pool.run(chunks, [&](size_t index) {
+        function(count * index / chunks, count * (index + 1) / chunks);
+    });
+}
+
+//row to pivot on in column `column` among order[from..rows): the first nonzero one for exact fields, the largest
+//in magnitude for floating ones; rows if the column is zero there
+template <typename Field>
+size_t pivot_row(const Field* data, size_t stride, const std::vector<size_t>& order, size_t from, size_t rows,
+                 size_t column) {
+    size_t ans = rows;
+    if constexpr (std::is_floating_point_v<Field>) {
+        Field best = Field(0);
+        for (size_t j = from; j < rows; ++j) {
+            Field value = std::abs(data[order[j] * stride + column]);
+            if (value > best) {
+                best = value;
+                ans = j;
+            }
+        }
+    }
+    else {
+        for (size_t j = from; j < rows; ++j) {
+            if (!FieldTraits<Field>::is_zero(data[order[j] * stride + column])) {
+                ans = j;
+                break;
+            }
+        }
+    }
+    return ans;
+}
+
+//moves row order[k] of the block to position k, order becomes the identity
+template <typename Field>
+void permute_rows(Field* data, size_t stride, size_t columns, std::vector<size_t>& order) {
+    for (size_t i = 0; i < order.size(); ++i) {
+        size_t j = i;
+        while (order[j] != i) {
+            size_t next = order[j];
+            std::swap_ranges(data + j * stride, data + j * stride + columns, data + next * stride);
+            order[j] = j;
+            j = next;
+        }
+        order[j] = j;
+    }
+}
+
+//elimination is done in panels of this many columns
+inline constexpr size_t gauss_panel = 64;
+
+//the width from which lu_factorize works in panels: the gathered update only pays for itself on one core once the
+//trailing blocks are large, except for double, whose packed kernel wins from a couple of panels on
+template <typename Field>
+struct BlockedLuThreshold {
+    static constexpr size_t value = 1024;
+};
+
+template <>
+struct BlockedLuThreshold<double> {
+    static constexpr size_t value = 2 * gauss_panel;
+};
+
+//right-looking PA = LU on a row-major block in place: order is the row permutation, pivot_columns gets the column
+//of every pivot and each multiplier is left where the entry it eliminated was; the columns of a panel are eliminated
+//first, then the rest of the rows are brought up to date in parallel. Over exact fields these are the same
+//operations as unblocked, so the result is the same; for double the packed multiply_add kernel rounds differently
+//and the factors agree only up to rounding. Returns whether the permutation is odd
+template <typename Field>
+bool lu_factorize(Field* data, size_t stride, size_t rows, size_t columns, std::vector<size_t>& order,
+                  std::vector<size_t>& pivot_columns) {
+    order.resize(rows);
+    std::iota(order.begin(), order.end(), 0);
+    pivot_columns.clear();
+    bool negated = false;
+    size_t block = columns > BlockedLuThreshold<Field>::value ? gauss_panel : columns;
+    for (size_t begin = 0; begin < columns && pivot_columns.size() < rows; begin += block) {
+        size_t end = std::min(columns, begin + block);
+        size_t first = pivot_columns.size();
+        for (size_t i = begin; i < end && pivot_columns.size() < rows; ++i) {
+            size_t str_ind = pivot_columns.size();
+            size_t ind_whithout_zero = pivot_row(data, stride, order, str_ind, rows, i);
+            if (ind_whithout_zero == rows) {
+                continue;
+            }
+            if (ind_whithout_zero != str_ind) {
+                std::swap(order[str_ind], order[ind_whithout_zero]);
+                negated = !negated;
+            }
+            const Field* pivot_row = data + order[str_ind] * stride;
+            parallel_for(rows - str_ind - 1, end - i, [&](size_t from, size_t to) {
+                for (size_t j = str_ind + 1 + from; j < str_ind + 1 + to; ++j) {
+                    Field* row = data + order[j] * stride;
+                    if (FieldTraits<Field>::is_zero(row[i])) {
+                        continue;
+                    }
+                    row[i] /= pivot_row[i];
+                    const Field& coeff = row[i];
+                    subtractMultiple(row + i + 1, pivot_row + i + 1, coeff, end - i - 1);
+                }
+            });
+            pivot_columns.push_back(i);
+        }
+        size_t last = pivot_columns.size();
+        if (end == columns || first == last) {
+            continue;
+        }
+        //the pivot rows of the panel first, each needs the ones above it
+        for (size_t k = first + 1; k < last; ++k) {
+            Field* row = data + order[k] * stride;
+            for (size_t j = first; j < k; ++j) {
+                const Field& coeff = row[pivot_columns[j]];
+                if (!FieldTraits<Field>::is_zero(coeff)) {
+                    subtractMultiple(row + end, data + order[j] * stride + end, coeff, columns - end);
+                }
+            }
+        }
+        size_t depth = last - first;
+        size_t width = columns - end;
+        if constexpr (std::is_trivially_copyable_v<Field>) {
+            //the rest is A22 -= L21 * U12, gathered by chunks of rows into blocks for multiply_add
+            std::vector<Field> right(depth * width);
+            for (size_t j = 0; j < depth; ++j) {
+                const Field* source = data + order[first + j] * stride + end;
+                std::copy(source, source + width, right.begin() + j * width);
+            }
+            parallel_for(rows - last, depth * width, [&](size_t from, size_t to) {
+                std::vector<Field> left;
+                std::vector<Field> target;
+                for (size_t chunk = from; chunk < to; chunk += gauss_panel) {
+                    size_t height = std::min(gauss_panel, to - chunk);
+                    left.resize(height * depth);
+                    target.resize(height * width);
+                    for (size_t r = 0; r < height; ++r) {
+                        const Field* row = data + order[last + chunk + r] * stride;
+                        for (size_t j = 0; j < depth; ++j) {
+                            left[r * depth + j] = -row[pivot_columns[first + j]];
+                        }
+                        std::copy(row + end, row + columns, target.begin() + r * width);
+                    }
+                    multiply_add(left.data(), depth, right.data(), width, target.data(), width, height, depth, width);
+                    for (size_t r = 0; r < height; ++r) {
+                        std::copy(target.begin() + r * width, target.begin() + (r + 1) * width,
+                                  data + order[last + chunk + r] * stride + end);
+                    }
+                }
+            });
+        }
+        else {
+            parallel_for(rows - last, depth * width, [&](size_t from, size_t to) {
+                for (size_t r = last + from; r < last + to; ++r) {
+                    Field* row = data + order[r] * stride;
+                    for (size_t j = first; j < last; ++j) {
+                        const Field& coeff = row[pivot_columns[j]];
+                        if (!FieldTraits<Field>::is_zero(coeff)) {
+                            subtractMultiple(row + end, data + order[j] * stride + end, coeff, width);
+                        }
+                    }
+                }
+            });
+        }
+    }
+    return negated;
+}
+
+//forward elimination to a row echelon form on a row-major block; rows are swapped through a permutation vector
+//and put in place at the end, returns whether the permutation is odd
+template <typename Field>
+bool gauss_method(Field* data, size_t stride, size_t rows, size_t columns) {
+    std::vector<size_t> order;
+    std::vector<size_t> pivot_columns;
+    bool negated = lu_factorize(data, stride, rows, columns, order, pivot_columns);
+    for (size_t k = 0; k < pivot_columns.size(); ++k) {
+        for (size_t j = k + 1; j < rows; ++j) {
+            data[order[j] * stride + pivot_columns[k]] = FieldTraits<Field>::zero;
+        }
+    }
+    permute_rows(data, stride, columns, order);
+    return negated;
+}
+
+//Gauss-Jordan on a square block, ans starts as the identity and ends as the inverse; the rows are eliminated
+//in parallel under each pivot
+template <typename Field>
+void gauss_jordan_invert(Field* data, Field* ans, size_t stride, size_t size) {
+    std::vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    size_t str_ind = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (str_ind == size) {
+            break;
+        }
+        size_t ind_whithout_zero = pivot_row(data, stride, order, str_ind, size, i);
+        if (ind_whithout_zero == size) {
+            continue;
+        }
+        std::swap(order[str_ind], order[ind_whithout_zero]);
+        size_t pivot = order[str_ind];
+        parallel_for(size, 2 * size, [&](size_t from, size_t to) {
+            for (size_t j = from; j < to; ++j) {
+                size_t row = order[j];
+                if (j == str_ind || FieldTraits<Field>::is_zero(data[row * stride + i])) {
+                    continue;
+                }
+                Field k = data[row * stride + i] / data[pivot * stride + i];
+                subtractMultiple(data + row * stride, data + pivot * stride, k, size);
+                subtractMultiple(ans + row * stride, ans + pivot * stride, k, size);
+            }
+        });
+        ++str_ind;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        const Field& pivot = data[order[i] * stride + i];
+        if (FieldTraits<Field>::is_one(pivot)) {
+            continue;
+        }
+        Field inverse = Field(1) / pivot;
+        for (size_t q = 0; q < size; ++q) {
+            ans[order[i] * stride + q] *= inverse;
+        }
+    }
+    permute_rows(ans, stride, size, order);
+}
+
+//Bareiss fraction-free elimination to a row echelon form: every division is exact, so the entries stay integers
+//bounded by minors of the input; returns the rank, negated tells whether an odd number of rows were swapped
+size_t bareiss_method(BigInteger* data, size_t stride, size_t rows, size_t columns, bool& negated) {
+    negated = false;
+    BigInteger previous = 1;
+    size_t rank = 0;
+    for (size_t i = 0; i < columns && rank < rows; ++i) {
+        size_t ind_whithout_zero = rows;
+        for (size_t j = rank; j < rows; ++j) {
+            if (data[j * stride + i] != 0) {
+                ind_whithout_zero = j;
+                break;
+            }
+        }
+        if (ind_whithout_zero == rows) {
+            continue;
+        }
+        BigInteger* pivot_row = data + rank * stride;
+        if (ind_whithout_zero != rank) {
+            std::swap_ranges(pivot_row, pivot_row + columns, data + ind_whithout_zero * stride);
+            negated = !negated;
+        }
+        const BigInteger& pivot = pivot_row[i];
+        bool divide = (previous != 1);
+        for (size_t j = rank + 1; j < rows; ++j) {
+            BigInteger* row = data + j * stride;
+            for (size_t q = i + 1; q < columns; ++q) {
+                row[q] *= pivot;
+                if (row[i] != 0) {
+                    row[q] -= row[i] * pivot_row[q];
+                }
+                if (divide) {
+                    row[q] /= previous;
+                }
+            }
+            row[i] = 0;
+        }
+        previous = pivot;
+        ++rank;
+    }
+    return rank;
+}
+
+//the same elimination on machine integers; false as soon as an entry leaves [-2^62, 2^62],
+//which keeps every product and difference inside __int128
+bool bareiss_method_small(long long* data, size_t stride, size_t rows, size_t columns, bool& negated, size_t& rank) {
+    const __int128 limit = static_cast<__int128>(1) << 62;
+    negated = false;
+    long long previous = 1;
+    rank = 0;
+    for (size_t i = 0; i < columns && rank < rows; ++i) {
+        size_t ind_whithout_zero = rows;
+        for (size_t j = rank; j < rows; ++j) {
+            if (data[j * stride + i] != 0) {
+                ind_whithout_zero = j;
+                break;
+            }
+        }
+        if (ind_whithout_zero == rows) {
+            continue;
+        }
+        long long* pivot_row = data + rank * stride;
+        if (ind_whithout_zero != rank) {
+            std::swap_ranges(pivot_row, pivot_row + columns, data + ind_whithout_zero * stride);
+            negated = !negated;
+        }
+        long long pivot = pivot_row[i];
+        for (size_t j = rank + 1; j < rows; ++j) {
+            long long* row = data + j * stride;
+            for (size_t q = i + 1; q < columns; ++q) {
+                __int128 value = (static_cast<__int128>(row[q]) * pivot - static_cast<__int128>(row[i]) * pivot_row[q]) / previous;
+                if (value > limit || value < -limit) {
+                    return false;
+                }
+                row[q] = static_cast<long long>(value);
+            }
+            row[i] = 0;
+        }
+        previous = pivot;
+        ++rank;
+    }
+    return true;
+}
+
+//integer rows proportional to the rows of a rational block: each row is multiplied by the lcm of its denominators,
+//scale collects the product of these lcms. The lcm is kept in a long long while it fits and goes on as a BigInteger,
+//so a large shared denominator costs one exact division per entry instead of the gcds of the field elimination
+void integer_rows(const Rational* data, size_t stride, size_t rows, size_t columns,
+                  std::vector<BigInteger>& ans, BigInteger& scale) {
+    ans.resize(rows * columns);
+    scale = 1;
+    for (size_t i = 0; i < rows; ++i) {
+        const Rational* row = data + i * stride;
+        long long small_multiplier = 1;
+        bool small = true;
+        BigInteger multiplier;
+        for (size_t j = 0; j < columns; ++j) {
+            BigInteger denominator = row[j].getDenominator();
+            if (small && denominator.fitsLongLong()) {
+                long long value = static_cast<long long>(denominator);
+                __int128 lcm = static_cast<__int128>(small_multiplier / std::gcd(small_multiplier, value)) * value;
+                if (lcm <= LLONG_MAX) {
+                    small_multiplier = static_cast<long long>(lcm);
+                    continue;
+                }
+            }
+            if (small) {
+                multiplier = small_multiplier;
+                small = false;
+            }
+            multiplier /= gcd(multiplier, denominator);
+            multiplier *= denominator;
+        }
+        for (size_t j = 0; j < columns; ++j) {
+            if (small) {
+                ans[i * columns + j] = row[j].getNumerator() * BigInteger(small_multiplier / static_cast<long long>(row[j].getDenominator()));
+            }
+            else {
+                ans[i * columns + j] = row[j].getNumerator() * (multiplier / row[j].getDenominator());
+            }
+        }
+        scale *= small ? BigInteger(small_multiplier) : multiplier;
+    }
+}
+
+//rank and signed last pivot of an integer block, through machine integers while the entries stay small
+size_t bareiss_rank(std::vector<BigInteger>& values, size_t rows, size_t columns, BigInteger& last_pivot) {
+    bool negated;
+    size_t rank;
+    if (std::all_of(values.begin(), values.end(), [](const BigInteger& value) { return value.fitsLongLong(); })) {
+        std::vector<long long> small(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            small[i] = static_cast<long long>(values[i]);
+        }
+        if (bareiss_method_small(small.data(), columns, rows, columns, negated, rank)) {
+            last_pivot = small.empty() ? 1 : small.back();
+            if (negated) {
+                last_pivot.ChangeSign();
+            }
+            return rank;
+        }
+    }
+    rank = bareiss_method(values.data(), columns, rows, columns, negated);
+    last_pivot = values.empty() ? BigInteger(1) : values.back();
+    if (negated) {
+        last_pivot.ChangeSign();
+    }
+    return rank;
+}
+
+//fraction-free paths of det() and rank(), used for integer and rational matrices;
+//false sends the caller to the field elimination
+template <typename Field>
+bool fraction_free_det(const Field*, size_t, size_t, Field&) {
+    return false;
+}
+
+template <typename Field>
+bool fraction_free_rank(const Field*, size_t, size_t, size_t, size_t&) {
+    return false;
+}
+
+bool fraction_free_det(const BigInteger* data, size_t stride, size_t size, BigInteger& ans) {
+    std::vector<BigInteger> values(size * size);
+    for (size_t i = 0; i < size; ++i) {
+        std::copy(data + i * stride, data + i * stride + size, values.begin() + i * size);
+    }
+    if (bareiss_rank(values, size, size, ans) < size) {
+        ans = 0;
+    }
+    return true;
+}
+
+bool fraction_free_rank(const BigInteger* data, size_t stride, size_t rows, size_t columns, size_t& ans) {
+    std::vector<BigInteger> values(rows * columns);
+    for (size_t i = 0; i < rows; ++i) {
+        std::copy(data + i * stride, data + i * stride + columns, values.begin() + i * columns);
+    }
+    BigInteger last_pivot;
+    ans = bareiss_rank(values, rows, columns, last_pivot);
+    return true;
+}
+
+bool fraction_free_det(const Rational* data, size_t stride, size_t size, Rational& ans) {
+    std::vector<BigInteger> values;
+    BigInteger scale;
+    integer_rows(data, stride, size, size, values, scale);
+    BigInteger det;
+    if (bareiss_rank(values, size, size, det) < size) {
+        det = 0;
+    }
+    ans = Rational(det, scale);
+    return true;
+}
+
+bool fraction_free_rank(const Rational* data, size_t stride, size_t rows, size_t columns, size_t& ans) {
+    std::vector<BigInteger> values;
+    BigInteger scale;
+    integer_rows(data, stride, rows, columns, values, scale);
+    BigInteger last_pivot;
+    ans = bareiss_rank(values, rows, columns, last_pivot);
+    return true;
+}
+
+//log2 |value|, -HUGE_VAL for zero
+double log2_abs(const BigInteger& value) {
+    if (value == 0) {
+        return -HUGE_VAL;
+    }
+    size_t used = std::min<size_t>(value.length(), 3);
+    return std::log2(value.leadingDigits(used)) + static_cast<double>(value.length() - used) * std::log2(1e9);
+}
+
+//the next prime below candidate, for the multi-modular algorithms that walk down from 2^62
+uint64_t previous_prime(uint64_t candidate) {
+    do {
+        --candidate;
+    } while (!is_prime(candidate));
+    return candidate;
+}
+
+//the largest prime below a random point of [2^61, 2^62), so the primes cannot be known when the input is made
+uint64_t random_prime(std::mt19937_64& generator) {
+    return previous_prime((uint64_t(1) << 61) + generator() % (uint64_t(1) << 61));
+}
+
+//returned by the modular images when the prime divides a denominator and has to be skipped
+inline constexpr uint64_t unlucky_prime = UINT64_MAX;
+
+//f(p) for every prime, split over the hardware threads; each call builds its own reduction, so nothing is shared
+template <typename Function>
+std::vector<uint64_t> map_primes(const std::vector<uint64_t>& primes, Function function) {
+    size_t threads = std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), primes.size());
+    std::vector<uint64_t> ans(primes.size());
+    std::vector<std::future<void>> tasks;
+    for (size_t t = 1; t < threads; ++t) {
+        tasks.push_back(std::async(std::launch::async, [&, t] {
+            for (size_t i = t; i < primes.size(); i += threads) {
+                ans[i] = function(primes[i]);
+            }
+        }));
+    }
+    for (size_t i = 0; i < primes.size(); i += threads) {
+        ans[i] = function(primes[i]);
+    }
+    for (auto& task : tasks) {
+        task.get();
+    }
+    return ans;
+}
+
+//a rational block reduced modulo an odd prime into Montgomery form; false when the prime divides a denominator
+bool modular_image(const std::vector<BigInteger>& numerators, const std::vector<BigInteger>& denominators,
+                   const MontgomeryReduction64& reduction, std::vector<uint64_t>& ans) {
+    ans.resize(numerators.size());
+    for (size_t i = 0; i < numerators.size(); ++i) {
+        uint64_t denominator = denominators[i] == 1 ? 1 : denominators[i].residue(reduction.mod);
+        uint64_t inverse = inverse_mod<uint64_t>(denominator, reduction.mod);
+        if (inverse == 0) {
+            return false;
+        }
+        ans[i] = reduction.multiply(reduction.transform(numerators[i].residue(reduction.mod)), reduction.transform(inverse));
+    }
+    return true;
+}
+
+//Gaussian elimination of a Montgomery-form block modulo a prime; returns the rank, det gets the determinant
+//when the block is square
+size_t eliminate_mod_prime(std::vector<uint64_t>& values, size_t rows, size_t columns,
+                           const MontgomeryReduction64& reduction, uint64_t& det) {
+    det = reduction.transform(1);
+    size_t rank = 0;
+    for (size_t i = 0; i < columns && rank < rows; ++i) {
+        size_t ind_whithout_zero = rows;
+        for (size_t j = rank; j < rows; ++j) {
+            if (values[j * columns + i] != 0) {
+                ind_whithout_zero = j;
+                break;
+            }
+        }
+        if (ind_whithout_zero == rows) {
+            det = 0;
+            continue;
+        }
+        uint64_t* pivot_row = values.data() + rank * columns;
+        if (ind_whithout_zero != rank) {
+            std::swap_ranges(pivot_row, pivot_row + columns, values.data() + ind_whithout_zero * columns);
+            det = reduction.subtract(0, det);
+        }
+        det = reduction.multiply(det, pivot_row[i]);
+        uint64_t inverse = reduction.transform(inverse_mod<uint64_t>(reduction.restore(pivot_row[i]), reduction.mod));
+        for (size_t j = rank + 1; j < rows; ++j) {
+            uint64_t* row = values.data() + j * columns;
+            if (row[i] == 0) {
+                continue;
+            }
+            uint64_t factor = reduction.multiply(row[i], inverse);
+            for (size_t q = i; q < columns; ++q) {
+                row[q] = reduction.subtract(row[q], reduction.multiply(factor, pivot_row[q]));
+            }
+        }
+        ++rank;
+    }
+    det = reduction.restore(det);
+    return rank;
+}
+
+//the determinant of a rational block from its images modulo 62-bit primes: the rows are scaled to integers by the
+//lcm of their denominators, the Hadamard bound of that integer matrix fixes how many primes are enough, and with
+//stable_primes > 0 the reconstruction stops early once that many further primes leave it unchanged
+Rational det_multi_modular(const Rational* data, size_t stride, size_t size, size_t stable_primes) {
+    std::vector<BigInteger> numerators(size * size);
+    std::vector<BigInteger> denominators(size * size);
+    BigInteger scale = 1;
+    double bound_bits = 0;
+    for (size_t i = 0; i < size; ++i) {
+        BigInteger multiplier = 1;
+        std::vector<double> logs(size);
+        for (size_t j = 0; j < size; ++j) {
+            numerators[i * size + j] = data[i * stride + j].getNumerator();
+            denominators[i * size + j] = data[i * stride + j].getDenominator();
+            const BigInteger& denominator = denominators[i * size + j];
+            if (denominator != 1) {
+                multiplier = multiplier / gcd(multiplier, denominator) * denominator;
+            }
+            logs[j] = log2_abs(numerators[i * size + j]) - log2_abs(denominator);
+        }
+        double largest = *std::max_element(logs.begin(), logs.end());
+        if (largest == -HUGE_VAL) {
+            return Rational(0);
+        }
+        double norm = 0;
+        for (double value : logs) {
+            norm += std::exp2(2 * (value - largest));
+        }
+        bound_bits += log2_abs(multiplier) + largest + std::log2(norm) / 2;
+        scale *= multiplier;
+    }
+    //the symmetric range of the product has to cover [-H, H]
+    size_t needed = static_cast<size_t>(std::ceil((bound_bits + 2) / 61.9)) + 1;
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    IncrementalChineseRemainder crt;
+    uint64_t candidate = uint64_t(1) << 62;
+    size_t used = 0;
+    while (used < needed) {
+        std::vector<uint64_t> primes(stable_primes > 0 ? std::min(threads, needed - used) : needed - used);
+        for (uint64_t& prime : primes) {
+            prime = candidate = previous_prime(candidate);
+        }
+        std::vector<uint64_t> images = map_primes(primes, [&](uint64_t prime) {
+            MontgomeryReduction64 reduction(prime);
+            std::vector<uint64_t> values;
+            if (!modular_image(numerators, denominators, reduction, values)) {
+                return unlucky_prime;
+            }
+            uint64_t det;
+            eliminate_mod_prime(values, size, size, reduction, det);
+            return multiply_mod(det, scale.residue(prime), prime);
+        });
+        for (size_t i = 0; i < primes.size(); ++i) {
+            if (images[i] == unlucky_prime) {
+                continue;
+            }
+            crt.add(primes[i], images[i]);
+            ++used;
+            if (stable_primes > 0 && crt.integerStable(stable_primes)) {
+                return Rational(crt.integer(), scale);
+            }
+        }
+    }
+    return Rational(crt.integer(), scale);
+}
+
+//the rank over Q is the largest rank modulo a prime, it drops only for primes dividing every maximal nonzero minor.
+//A minor of B bits has at most B / 61 prime factors above 2^61, while [2^61, 2^62) holds about 5 * 10^16 primes,
+//so a couple of primes drawn at random from there settle it with overwhelming probability for any fixed matrix
+size_t rank_multi_modular(const Rational* data, size_t stride, size_t rows, size_t columns, size_t prime_count) {
+    std::vector<BigInteger> numerators(rows * columns);
+    std::vector<BigInteger> denominators(rows * columns);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t j = 0; j < columns; ++j) {
+            numerators[i * columns + j] = data[i * stride + j].getNumerator();
+            denominators[i * columns + j] = data[i * stride + j].getDenominator();
+        }
+    }
+    size_t ans = 0;
+    size_t used = 0;
+    std::mt19937_64 generator(std::random_device{}());
+    while (used < std::max<size_t>(prime_count, 1)) {
+        std::vector<uint64_t> primes(std::max<size_t>(prime_count, 1) - used);
+        for (uint64_t& prime : primes) {
+            prime = random_prime(generator);
+        }
+        std::vector<uint64_t> ranks = map_primes(primes, [&](uint64_t prime) {
+            MontgomeryReduction64 reduction(prime);
+            std::vector<uint64_t> values;
+            if (!modular_image(numerators, denominators, reduction, values)) {
+                return unlucky_prime;
+            }
+            uint64_t det;
+            return static_cast<uint64_t>(eliminate_mod_prime(values, rows, columns, reduction, det));
+        });
+        for (uint64_t rank : ranks) {
+            if (rank != unlucky_prime) {
+                ans = std::max<size_t>(ans, rank);
+                ++used;
+            }
+        }
+    }
+    return ans;
+}
+
+//base of everything that can stand on either side of an element-wise matrix operation: Matrix itself and
+//the lazy nodes built by +, - and scaling, which are only evaluated when assigned to a Matrix
+template <size_t M, size_t N, typename Field, typename Expression>
+struct MatrixExpression {
+    const Expression& expression() const {
+        return static_cast<const Expression&>(*this);
+    }
+};
+
+template<size_t M, size_t N = M, typename Field = Rational>
+class Matrix : public MatrixExpression<M, N, Field, Matrix<M, N, Field>> {
+private:
+    std::array<std::array<Field, N>, M> arr;
+
+    Matrix& Gauss_method() {
+        gauss_method(arr[0].data(), N, M, N);
+        return *this;
+    }
+
+    template <typename Expression>
+    Matrix& accumulate(const MatrixExpression<M, N, Field, Expression>& expression, bool subtract) {
+        const Expression& value = expression.expression();
+        if (value.refersTo(this)) {
+            Matrix copy(expression);
+            return subtract ? *this -= copy : *this += copy;
+        }
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                value.accumulate(arr[i][j], i, j, subtract);
+            }
+        }
+        return *this;
+    }
+public:
+    Matrix() {
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                arr[i][j] = Field(0);
+            }
+        }
+    };
+
+    Matrix(const std::array<std::array<Field, N>, M>& arr) : arr(arr) {}
+
+    //one pass over the entries, each of them built in place by the expression
+    template <typename Expression>
+    Matrix(const MatrixExpression<M, N, Field, Expression>& expression) {
+        const Expression& value = expression.expression();
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                value.evaluate(arr[i][j], i, j);
+            }
+        }
+    }
+
+    Matrix(const Matrix& other) = default;
+
+    Matrix& operator=(const Matrix& other) = default;
+
+    template <typename Expression>
+    Matrix& operator=(const MatrixExpression<M, N, Field, Expression>& expression) {
+        const Expression& value = expression.expression();
+        if (value.refersTo(this)) {
+            return *this = Matrix(expression);
+        }
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                value.evaluate(arr[i][j], i, j);
+            }
+        }
+        return *this;
+    }
+
+    template <typename Expression>
+    Matrix& operator+=(const MatrixExpression<M, N, Field, Expression>& expression) {
+        return accumulate(expression, false);
+    }
+
+    template <typename Expression>
+    Matrix& operator-=(const MatrixExpression<M, N, Field, Expression>& expression) {
+        return accumulate(expression, true);
+    }
+
+    template <typename T>
+    Matrix(std::initializer_list<std::initializer_list<T>> list) {
+        int ind1 = 0;
+        for (auto sub_list : list) {
+            if (ind1 == M) {
+                break;
+            }
+            int ind2 = 0;
+            for (T val : sub_list) {
+                if (ind2 == N) {
+                    break;
+                }
+                arr[ind1][ind2] = static_cast<Field>(val);
+                ++ind2;
+            }
+            ++ind1;
+        }
+    }
+
+    std::array<Field, N>& operator[](int index) {
+        return arr[index];
+    }
+
+    const std::array<Field, N>& operator[](int index) const {
+        return arr[index];
+    }
+
+    Matrix operator-() const {
+        Matrix copy = (*this);
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                copy[i][j] = -copy[i][j];
+            }
+        }
+        return copy;
+    }
+
+    Matrix& operator+=(const Matrix& other) {
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                arr[i][j] += other.arr[i][j];
+            }
+        }
+        return *this;
+    }
+
+    Matrix& operator-=(const Matrix& other) {
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                arr[i][j] -= other.arr[i][j];
+            }
+        }
+        return *this;
+    }
+
+    Matrix& operator*=(Field val) {
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                arr[i][j] *= val;
+            }
+        }
+        return *this;
+    }
+
+    Matrix inverted() const {
+        static_assert(N == M);
+        Matrix copy = *this;
+        copy.invert();
+        return copy;
+    }
+
+    Matrix& invert() {
+        static_assert(N == M);
+        Matrix ans;
+        for (size_t i = 0; i < N; ++i) {
+            ans[i][i] = Field(1);
+        }
+        gauss_jordan_invert(arr[0].data(), ans.arr[0].data(), N, N);
+        return *this = ans;
+    }
+
+    Matrix<N, M, Field> transposed() const {
+        Matrix<N, M, Field> ans;
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                ans[j][i] = arr[i][j];
+            }
+        }
+        return ans;
+    }
+
+    Field det() const {
+        static_assert(N == M);
+        Field fraction_free;
+        if (fraction_free_det(arr[0].data(), N, N, fraction_free)) {
+            return fraction_free;
+        }
+        Matrix triangle_matr = *this;
+        bool negated = gauss_method(triangle_matr.arr[0].data(), N, N, N);
+        Field ans = Field(1);
+        for (size_t i = 0; i < N; ++i) {
+            ans *= triangle_matr.arr[i][i];
+        }
+        if (negated) {
+            FieldTraits<Field>::negate_inplace(ans);
+        }
+        return ans;
+    }
+
+    //det() through residues modulo 62-bit primes, as many as the Hadamard bound asks for;
+    //stable_primes > 0 stops once that many further primes leave the result unchanged
+    Rational detMultiModular(size_t stable_primes = 0) const {
+        static_assert(N == M && std::is_same_v<Field, Rational>);
+        return det_multi_modular(arr[0].data(), N, N, stable_primes);
+    }
+
+    size_t rankMultiModular(size_t prime_count = 2) const {
+        static_assert(std::is_same_v<Field, Rational>);
+        return rank_multi_modular(arr[0].data(), N, M, N, prime_count);
+    }
+
+    Field trace() const {
+        static_assert(N == M);
+        Field ans = Field(0);
+        for (size_t i = 0; i < N; ++i) {
+            ans += arr[i][i];
+        }
+        return ans;
+    }
+
+    size_t rank() const {
+        size_t fraction_free;
+        if (fraction_free_rank(arr[0].data(), N, M, N, fraction_free)) {
+            return fraction_free;
+        }
+        Matrix triangle_matr = *this;
+        triangle_matr.Gauss_method();
+        for (size_t i = 0; i < M; ++i) {
+            bool zero = true;
+            for (size_t j = 0; j < N; ++j) {
+                if (!FieldTraits<Field>::is_zero(triangle_matr.arr[i][j])) {
+                    zero = false;
+                    break;
+                }
+            }
+            if (zero) {
+                return i;
+            }
+        }
+        return M;
+    }
+
+    std::array<Field, N> getRow(size_t index) const {
         return arr[index];
     }
 
-    Matrix operator-() const {
-        Matrix copy = (*this);
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                copy[i][j] = -copy[i][j];
-            }
+    std::array<Field, M> getColumn(size_t index) const {
+        std::array<Field, M> ans;
+        for (size_t i = 0; i < M; ++i) {
+            ans[i] = arr[i][index];
+        }
+        return ans;
+    }
+
+    template<size_t K>
+    Matrix<M, K, Field> operator*=(const Matrix<N, K, Field>& other);
+};
+
+template<size_t M, size_t N, typename Field>
+template<size_t K>
+Matrix<M, K, Field> Matrix<M, N, Field>::operator*=(const Matrix<N, K, Field>& other) {
+    return *this = (*this) * other;
+}
+
+//floating point fields stay on the classical kernel, Strassen-Winograd loses accuracy there
+template <typename Field>
+size_t square_workspace_size(size_t size) {
+    return std::is_floating_point_v<Field> ? 0 : strassen_workspace_size<Field>(size);
+}
+
+//ans = first * second for N x N row-major blocks that do not overlap ans
+template <size_t N, typename Field>
+void multiply_square(const Field* first, const Field* second, Field* ans, Field* workspace) {
+    if constexpr (!std::is_floating_point_v<Field>) {
+        if (N > StrassenThreshold<Field>::value) {
+            strassen_multiply(first, N, second, N, ans, N, N, workspace);
+            return;
+        }
+    }
+    std::fill(ans, ans + N * N, FieldTraits<Field>::zero);
+    multiply_add(first, N, second, N, ans, N, N, N, N);
+}
+
+template<size_t M, size_t N, size_t K, typename Field = Rational>
+Matrix<M, K, Field> operator*(const Matrix<M, N, Field>& first, const Matrix<N, K, Field>& second) {
+    static_assert(sizeof(std::array<Field, N>) == N * sizeof(Field));
+    Matrix<M, K, Field> ans;
+    if constexpr (M == N && N == K) {
+        std::vector<Field> workspace(square_workspace_size<Field>(N));
+        multiply_square<N>(first[0].data(), second[0].data(), ans[0].data(), workspace.data());
+        return ans;
+    }
+    else {
+        multiply_add(first[0].data(), N, second[0].data(), K, ans[0].data(), K, M, N, K);
+        return ans;
+    }
+}
+
+//a Matrix operand of an expression, held by reference
+template <size_t M, size_t N, typename Field>
+class MatrixReference {
+private:
+    const Matrix<M, N, Field>& matrix;
+public:
+    explicit MatrixReference(const Matrix<M, N, Field>& matrix) : matrix(matrix) {}
+
+    void evaluate(Field& out, size_t i, size_t j) const {
+        out = matrix[i][j];
+    }
+
+    void accumulate(Field& out, size_t i, size_t j, bool subtract) const {
+        if (subtract) {
+            out -= matrix[i][j];
+        }
+        else {
+            out += matrix[i][j];
+        }
+    }
+
+    void accumulateScaled(Field& out, size_t i, size_t j, const Field& factor, bool subtract) const {
+        if (subtract) {
+            FieldTraits<Field>::fms(out, matrix[i][j], factor);
+        }
+        else {
+            FieldTraits<Field>::fma(out, matrix[i][j], factor);
+        }
+    }
+
+    bool refersTo(const void* pointer) const {
+        return &matrix == pointer;
+    }
+};
+
+//how an operand is kept inside a node: matrices by reference, nodes by value
+template <typename Expression>
+struct ExpressionNode {
+    using type = Expression;
+};
+
+template <size_t M, size_t N, typename Field>
+struct ExpressionNode<Matrix<M, N, Field>> {
+    using type = MatrixReference<M, N, Field>;
+};
+
+//the read-only part of the Matrix interface on the nodes, so that (a + b)[i][j] or (a * k).det() work as on a
+//Matrix: entries, rows, columns and the trace are computed on demand, the rest on a Matrix built from the node.
+//Reading many entries this way recomputes them, assigning the node to a Matrix first is cheaper
+template <size_t M, size_t N, typename Field, typename Node>
+struct MatrixNode : MatrixExpression<M, N, Field, Node> {
+    std::array<Field, N> operator[](int index) const {
+        return getRow(index);
+    }
+
+    std::array<Field, N> getRow(size_t index) const {
+        std::array<Field, N> ans;
+        for (size_t j = 0; j < N; ++j) {
+            this->expression().evaluate(ans[j], index, j);
+        }
+        return ans;
+    }
+
+    std::array<Field, M> getColumn(size_t index) const {
+        std::array<Field, M> ans;
+        for (size_t i = 0; i < M; ++i) {
+            this->expression().evaluate(ans[i], i, index);
+        }
+        return ans;
+    }
+
+    Matrix<N, M, Field> transposed() const {
+        Matrix<N, M, Field> ans;
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                this->expression().evaluate(ans[j][i], i, j);
+            }
+        }
+        return ans;
+    }
+
+    Field trace() const {
+        static_assert(N == M);
+        Field ans = Field(0);
+        Field entry;
+        for (size_t i = 0; i < N; ++i) {
+            this->expression().evaluate(entry, i, i);
+            ans += entry;
+        }
+        return ans;
+    }
+
+    Matrix<M, N, Field> inverted() const {
+        return Matrix<M, N, Field>(*this).inverted();
+    }
+
+    Field det() const {
+        return Matrix<M, N, Field>(*this).det();
+    }
+
+    Rational detMultiModular(size_t stable_primes = 0) const {
+        return Matrix<M, N, Field>(*this).detMultiModular(stable_primes);
+    }
+
+    size_t rank() const {
+        return Matrix<M, N, Field>(*this).rank();
+    }
+
+    size_t rankMultiModular(size_t prime_count = 2) const {
+        return Matrix<M, N, Field>(*this).rankMultiModular(prime_count);
+    }
+};
+
+//every node can write its value into an entry, add it to one (or subtract it) and add it times a factor, so a
+//linear combination of matrices is computed into the destination by +=, -= and fms without any temporary
+template <size_t M, size_t N, typename Field, typename Left, typename Right, bool Subtract>
+class MatrixSum : public MatrixNode<M, N, Field, MatrixSum<M, N, Field, Left, Right, Subtract>> {
+private:
+    typename ExpressionNode<Left>::type left;
+    typename ExpressionNode<Right>::type right;
+public:
+    MatrixSum(const Left& left, const Right& right) : left(left), right(right) {}
+
+    void evaluate(Field& out, size_t i, size_t j) const {
+        left.evaluate(out, i, j);
+        right.accumulate(out, i, j, Subtract);
+    }
+
+    void accumulate(Field& out, size_t i, size_t j, bool subtract) const {
+        left.accumulate(out, i, j, subtract);
+        right.accumulate(out, i, j, subtract != Subtract);
+    }
+
+    void accumulateScaled(Field& out, size_t i, size_t j, const Field& factor, bool subtract) const {
+        left.accumulateScaled(out, i, j, factor, subtract);
+        right.accumulateScaled(out, i, j, factor, subtract != Subtract);
+    }
+
+    bool refersTo(const void* pointer) const {
+        return left.refersTo(pointer) || right.refersTo(pointer);
+    }
+};
+
+template <size_t M, size_t N, typename Field, typename Operand>
+class MatrixScaled : public MatrixNode<M, N, Field, MatrixScaled<M, N, Field, Operand>> {
+private:
+    typename ExpressionNode<Operand>::type operand;
+    Field factor;
+public:
+    MatrixScaled(const Operand& operand, const Field& factor) : operand(operand), factor(factor) {}
+
+    void evaluate(Field& out, size_t i, size_t j) const {
+        operand.evaluate(out, i, j);
+        out *= factor;
+    }
+
+    void accumulate(Field& out, size_t i, size_t j, bool subtract) const {
+        operand.accumulateScaled(out, i, j, factor, subtract);
+    }
+
+    void accumulateScaled(Field& out, size_t i, size_t j, const Field& other, bool subtract) const {
+        operand.accumulateScaled(out, i, j, factor * other, subtract);
+    }
+
+    bool refersTo(const void* pointer) const {
+        return operand.refersTo(pointer);
+    }
+};
+
+template <size_t M, size_t N, typename Field, typename Operand>
+class MatrixNegation : public MatrixNode<M, N, Field, MatrixNegation<M, N, Field, Operand>> {
+private:
+    typename ExpressionNode<Operand>::type operand;
+public:
+    explicit MatrixNegation(const Operand& operand) : operand(operand) {}
+
+    void evaluate(Field& out, size_t i, size_t j) const {
+        operand.evaluate(out, i, j);
+        FieldTraits<Field>::negate_inplace(out);
+    }
+
+    void accumulate(Field& out, size_t i, size_t j, bool subtract) const {
+        operand.accumulate(out, i, j, !subtract);
+    }
+
+    void accumulateScaled(Field& out, size_t i, size_t j, const Field& factor, bool subtract) const {
+        operand.accumulateScaled(out, i, j, factor, !subtract);
+    }
+
+    bool refersTo(const void* pointer) const {
+        return operand.refersTo(pointer);
+    }
+};
+
+//the nodes keep references to their matrices, an expression has to be assigned to a Matrix before its operands go
+//away. That includes temporaries: auto s = a * b + c; keeps a reference to the product, which is destroyed at the
+//end of the statement, so reading s later is undefined; Matrix s = a * b + c; is evaluated right there
+template <size_t M, size_t N, typename Field, typename Left, typename Right>
+MatrixSum<M, N, Field, Left, Right, false> operator+(const MatrixExpression<M, N, Field, Left>& first,
+                                                     const MatrixExpression<M, N, Field, Right>& second) {
+    return MatrixSum<M, N, Field, Left, Right, false>(first.expression(), second.expression());
+}
+
+template <size_t M, size_t N, typename Field, typename Left, typename Right>
+MatrixSum<M, N, Field, Left, Right, true> operator-(const MatrixExpression<M, N, Field, Left>& first,
+                                                    const MatrixExpression<M, N, Field, Right>& second) {
+    return MatrixSum<M, N, Field, Left, Right, true>(first.expression(), second.expression());
+}
+
+template <size_t M, size_t N, typename Field, typename Operand>
+MatrixNegation<M, N, Field, Operand> operator-(const MatrixExpression<M, N, Field, Operand>& operand) {
+    return MatrixNegation<M, N, Field, Operand>(operand.expression());
+}
+
+template <size_t M, size_t N, typename Field, typename Operand>
+MatrixScaled<M, N, Field, Operand> operator*(const MatrixExpression<M, N, Field, Operand>& matr, const Field& value) {
+    return MatrixScaled<M, N, Field, Operand>(matr.expression(), value);
+}
+
+template <size_t M, size_t N, typename Field, typename Operand>
+MatrixScaled<M, N, Field, Operand> operator*(const Field& value, const MatrixExpression<M, N, Field, Operand>& matr) {
+    return MatrixScaled<M, N, Field, Operand>(matr.expression(), value);
+}
+
+//an expression as a Matrix: a reference when it already is one, a fresh Matrix otherwise
+template <size_t M, size_t N, typename Field, typename Expression>
+decltype(auto) materialize(const MatrixExpression<M, N, Field, Expression>& expression) {
+    if constexpr (std::is_same_v<Expression, Matrix<M, N, Field>>) {
+        return (expression.expression());
+    }
+    else {
+        return Matrix<M, N, Field>(expression);
+    }
+}
+
+//products are where expressions get materialized
+template <size_t M, size_t N, size_t K, typename Field, typename Left, typename Right>
+Matrix<M, K, Field> operator*(const MatrixExpression<M, N, Field, Left>& first,
+                              const MatrixExpression<N, K, Field, Right>& second) {
+    return materialize(first) * materialize(second);
+}
+
+template <size_t M, size_t N, typename Field, typename Left, typename Right>
+bool operator==(const MatrixExpression<M, N, Field, Left>& first, const MatrixExpression<M, N, Field, Right>& second) {
+    const Matrix<M, N, Field>& left = materialize(first);
+    const Matrix<M, N, Field>& right = materialize(second);
+    for (size_t i = 0; i < M; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            if (left[i][j] != right[i][j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <size_t M, size_t N, typename Field, typename Left, typename Right>
+bool operator!=(const MatrixExpression<M, N, Field, Left>& first, const MatrixExpression<M, N, Field, Right>& second) {
+    return !(first == second);
+}
+
+template <size_t N, typename Field = Rational>
+using SquareMatrix = Matrix<N, N, Field>;
+
+//a companion matrix up to transposition and reversal of the index order: first row arbitrary, ones right below
+//the diagonal and zeros elsewhere. The four layouts differ only in where entry (i, j) of that form is stored
+template <size_t N>
+struct CompanionLayout {
+    bool transposed = false;
+    bool reversed = false;
+
+    std::pair<size_t, size_t> position(size_t i, size_t j) const {
+        if (reversed) {
+            i = N - 1 - i;
+            j = N - 1 - j;
+        }
+        return transposed ? std::make_pair(j, i) : std::make_pair(i, j);
+    }
+};
+
+template <size_t N, typename Field>
+bool find_companion_layout(const Matrix<N, N, Field>& matrix, CompanionLayout<N>& layout) {
+    for (int variant = 0; variant < 4; ++variant) {
+        layout.transposed = variant % 2 == 1;
+        layout.reversed = variant / 2 == 1;
+        bool fits = true;
+        for (size_t i = 1; i < N && fits; ++i) {
+            for (size_t j = 0; j < N && fits; ++j) {
+                auto [row, column] = layout.position(i, j);
+                const Field& value = matrix[row][column];
+                fits = j + 1 == i ? FieldTraits<Field>::is_one(value) : FieldTraits<Field>::is_zero(value);
+            }
+        }
+        if (fits) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//ans = first * second mod x^N - c_1 x^(N-1) - ... - c_N for polynomials of degree below N, reversed holds c_N, ..., c_1
+//and product is scratch of 2N - 1 entries
+template <size_t N, typename Field>
+void multiply_mod(const Field* first, const Field* second, const Field* reversed, Field* product, Field* ans) {
+    std::fill(product, product + 2 * N - 1, FieldTraits<Field>::zero);
+    for (size_t i = 0; i < N; ++i) {
+        if (!FieldTraits<Field>::is_zero(first[i])) {
+            addMultiple(product + i, second, first[i], N);
+        }
+    }
+    for (size_t d = 2 * N - 2; d >= N; --d) {
+        if (!FieldTraits<Field>::is_zero(product[d])) {
+            addMultiple(product + d - N, reversed, product[d], N);
+        }
+    }
+    std::copy(product, product + N, ans);
+}
+
+//Kitamasa: with c the first row and P(x) = x^N - c_1 x^(N-1) - ... - c_N its characteristic polynomial,
+//row 0 of the form maps e_0 to c and row i to e_(i-1), so row N-1-t of A^k is e_(N-1) A^(k+t) and its entry
+//N-1-j is the coefficient of x^j in x^(k+t) mod P. O(N^2 log k) instead of O(N^3 log k)
+template <size_t N, typename Field>
+Matrix<N, N, Field> companion_pow(const Matrix<N, N, Field>& matrix, const CompanionLayout<N>& layout, uint64_t power) {
+    std::vector<Field> buffer(7 * N - 1, FieldTraits<Field>::zero);
+    Field* reversed = buffer.data();
+    Field* ans = reversed + N;
+    Field* base = ans + N;
+    Field* next = base + N;
+    Field* product = next + N;
+    for (size_t j = 0; j < N; ++j) {
+        auto [row, column] = layout.position(0, N - 1 - j);
+        reversed[j] = matrix[row][column];
+    }
+    //x mod P, for N = 1 it is c_1 itself
+    if constexpr (N == 1) {
+        base[0] = reversed[0];
+    }
+    else {
+        base[1] = Field(1);
+    }
+    ans[0] = Field(1);
+    for (; power > 0; power /= 2) {
+        if (power % 2 == 1) {
+            multiply_mod<N>(ans, base, reversed, product, next);
+            std::swap(ans, next);
+        }
+        if (power > 1) {
+            multiply_mod<N>(base, base, reversed, product, next);
+            std::swap(base, next);
+        }
+    }
+    Matrix<N, N, Field> result;
+    for (size_t t = 0; t < N; ++t) {
+        if (t > 0) {
+            //times x: shift up and reduce the carried leading coefficient
+            Field carry = ans[N - 1];
+            std::copy_backward(ans, ans + N - 1, ans + N);
+            ans[0] = FieldTraits<Field>::zero;
+            if (!FieldTraits<Field>::is_zero(carry)) {
+                addMultiple(ans, reversed, carry, N);
+            }
+        }
+        for (size_t j = 0; j < N; ++j) {
+            auto [row, column] = layout.position(N - 1 - t, N - 1 - j);
+            result[row][column] = ans[j];
+        }
+    }
+    return result;
+}
+
+//binary exponentiation over three heap blocks swapped by pointer, with one Strassen workspace for all the products.
+//Companion matrices of linear recurrences take the polynomial route above
+template <size_t N, typename Field>
+Matrix<N, N, Field> pow(const Matrix<N, N, Field>& matrix, uint64_t power) {
+    static_assert(sizeof(std::array<Field, N>) == N * sizeof(Field));
+    CompanionLayout<N> layout;
+    if (find_companion_layout(matrix, layout)) {
+        return companion_pow(matrix, layout, power);
+    }
+    Matrix<N, N, Field> result;
+    if (power == 0) {
+        for (size_t i = 0; i < N; ++i) {
+            result[i][i] = Field(1);
+        }
+        return result;
+    }
+    std::vector<Field> buffer(3 * N * N);
+    std::vector<Field> workspace(square_workspace_size<Field>(N));
+    Field* ans = buffer.data();
+    Field* base = ans + N * N;
+    Field* next = base + N * N;
+    std::copy(matrix[0].data(), matrix[0].data() + N * N, base);
+    bool started = false;
+    for (; power > 0; power /= 2) {
+        if (power % 2 == 1) {
+            if (started) {
+                multiply_square<N>(ans, base, next, workspace.data());
+                std::swap(ans, next);
+            }
+            else {
+                std::copy(base, base + N * N, ans);
+                started = true;
+            }
+        }
+        if (power > 1) {
+            multiply_square<N>(base, base, next, workspace.data());
+            std::swap(base, next);
+        }
+    }
+    std::copy(ans, ans + N * N, result[0].data());
+    return result;
+}
+
+//the same matrix with runtime sizes and contiguous row-major storage on the heap
+template <typename Field = Rational>
+class DynMatrix {
+private:
+    size_t rowCount = 0;
+    size_t columnCount = 0;
+    std::vector<Field> values;
+
+    void checkSameSize(const DynMatrix& other) const {
+        if (rowCount != other.rowCount || columnCount != other.columnCount) {
+            throw std::invalid_argument("matrices of different sizes");
+        }
+    }
+
+    void checkSquare() const {
+        if (rowCount != columnCount) {
+            throw std::invalid_argument("the matrix is not square");
+        }
+    }
+public:
+    DynMatrix() = default;
+
+    DynMatrix(size_t rows, size_t columns) : rowCount(rows), columnCount(columns), values(rows * columns, Field(0)) {}
+
+    template <typename T>
+    DynMatrix(std::initializer_list<std::initializer_list<T>> list) : rowCount(list.size()) {
+        for (auto sub_list : list) {
+            columnCount = std::max(columnCount, sub_list.size());
+        }
+        values.assign(rowCount * columnCount, Field(0));
+        size_t ind1 = 0;
+        for (auto sub_list : list) {
+            size_t ind2 = 0;
+            for (T val : sub_list) {
+                values[ind1 * columnCount + ind2] = static_cast<Field>(val);
+                ++ind2;
+            }
+            ++ind1;
+        }
+    }
+
+    template <size_t M, size_t N, typename Expression>
+    explicit DynMatrix(const MatrixExpression<M, N, Field, Expression>& expression) : rowCount(M), columnCount(N),
+        values(M * N) {
+        if constexpr (std::is_same_v<Expression, Matrix<M, N, Field>>) {
+            const Matrix<M, N, Field>& matrix = expression.expression();
+            for (size_t i = 0; i < M; ++i) {
+                std::copy(matrix[i].begin(), matrix[i].end(), values.begin() + i * N);
+            }
+        }
+        else {
+            for (size_t i = 0; i < M; ++i) {
+                for (size_t j = 0; j < N; ++j) {
+                    expression.expression().evaluate(values[i * N + j], i, j);
+                }
+            }
+        }
+    }
+
+    DynMatrix(const DynMatrix& other) = default;
+
+    DynMatrix(DynMatrix&& other) noexcept : rowCount(std::exchange(other.rowCount, 0)),
+        columnCount(std::exchange(other.columnCount, 0)), values(std::move(other.values)) {}
+
+    DynMatrix& operator=(const DynMatrix& other) = default;
+
+    DynMatrix& operator=(DynMatrix&& other) noexcept {
+        rowCount = std::exchange(other.rowCount, 0);
+        columnCount = std::exchange(other.columnCount, 0);
+        values = std::move(other.values);
+        return *this;
+    }
+
+    static DynMatrix identity(size_t size) {
+        DynMatrix ans(size, size);
+        for (size_t i = 0; i < size; ++i) {
+            ans.values[i * size + i] = Field(1);
+        }
+        return ans;
+    }
+
+    size_t rows() const {
+        return rowCount;
+    }
+
+    size_t columns() const {
+        return columnCount;
+    }
+
+    Field* data() {
+        return values.data();
+    }
+
+    const Field* data() const {
+        return values.data();
+    }
+
+    std::span<Field> operator[](size_t index) {
+        return std::span<Field>(values.data() + index * columnCount, columnCount);
+    }
+
+    std::span<const Field> operator[](size_t index) const {
+        return std::span<const Field>(values.data() + index * columnCount, columnCount);
+    }
+
+    DynMatrix operator-() const {
+        DynMatrix copy = *this;
+        for (Field& value : copy.values) {
+            value = -value;
+        }
+        return copy;
+    }
+
+    DynMatrix& operator+=(const DynMatrix& other) {
+        checkSameSize(other);
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] += other.values[i];
+        }
+        return *this;
+    }
+
+    DynMatrix& operator-=(const DynMatrix& other) {
+        checkSameSize(other);
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] -= other.values[i];
+        }
+        return *this;
+    }
+
+    DynMatrix& operator*=(const Field& val) {
+        for (Field& value : values) {
+            value *= val;
+        }
+        return *this;
+    }
+
+    DynMatrix& operator*=(const DynMatrix& other);
+
+    DynMatrix inverted() const {
+        DynMatrix copy = *this;
+        copy.invert();
+        return copy;
+    }
+
+    DynMatrix& invert() {
+        checkSquare();
+        DynMatrix ans = identity(rowCount);
+        gauss_jordan_invert(values.data(), ans.values.data(), columnCount, rowCount);
+        return *this = std::move(ans);
+    }
+
+    DynMatrix transposed() const {
+        DynMatrix ans(columnCount, rowCount);
+        for (size_t i = 0; i < rowCount; ++i) {
+            for (size_t j = 0; j < columnCount; ++j) {
+                ans.values[j * rowCount + i] = values[i * columnCount + j];
+            }
+        }
+        return ans;
+    }
+
+    Field det() const {
+        checkSquare();
+        Field fraction_free;
+        if (fraction_free_det(values.data(), columnCount, rowCount, fraction_free)) {
+            return fraction_free;
         }
-        return copy;
+        DynMatrix triangle_matr = *this;
+        bool negated = gauss_method(triangle_matr.values.data(), columnCount, rowCount, columnCount);
+        Field ans = Field(1);
+        for (size_t i = 0; i < rowCount; ++i) {
+            ans *= triangle_matr.values[i * columnCount + i];
+        }
+        if (negated) {
+            FieldTraits<Field>::negate_inplace(ans);
+        }
+        return ans;
     }
 
-    Matrix& operator+=(const Matrix& other) {
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                arr[i][j] += other.arr[i][j];
-            }
+    //det() through residues modulo 62-bit primes, as many as the Hadamard bound asks for;
+    //stable_primes > 0 stops once that many further primes leave the result unchanged
+    Rational detMultiModular(size_t stable_primes = 0) const {
+        static_assert(std::is_same_v<Field, Rational>);
+        checkSquare();
+        return det_multi_modular(values.data(), columnCount, rowCount, stable_primes);
+    }
+
+    size_t rankMultiModular(size_t prime_count = 2) const {
+        static_assert(std::is_same_v<Field, Rational>);
+        return rank_multi_modular(values.data(), columnCount, rowCount, columnCount, prime_count);
+    }
+
+    Field trace() const {
+        checkSquare();
+        Field ans = Field(0);
+        for (size_t i = 0; i < rowCount; ++i) {
+            ans += values[i * columnCount + i];
         }
-        return *this;
+        return ans;
     }
 
-    Matrix& operator-=(const Matrix& other) {
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                arr[i][j] -= other.arr[i][j];
+    size_t rank() const {
+        size_t fraction_free;
+        if (fraction_free_rank(values.data(), columnCount, rowCount, columnCount, fraction_free)) {
+            return fraction_free;
+        }
+        DynMatrix triangle_matr = *this;
+        gauss_method(triangle_matr.values.data(), columnCount, rowCount, columnCount);
+        for (size_t i = 0; i < rowCount; ++i) {
+            auto row = triangle_matr[i];
+            if (std::all_of(row.begin(), row.end(), [](const Field& value) { return FieldTraits<Field>::is_zero(value); })) {
+                return i;
             }
         }
-        return *this;
+        return rowCount;
     }
 
-    Matrix& operator*=(Field val) {
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                arr[i][j] *= val;
-            }
+    std::vector<Field> getRow(size_t index) const {
+        return std::vector<Field>(values.begin() + index * columnCount, values.begin() + (index + 1) * columnCount);
+    }
+
+    std::vector<Field> getColumn(size_t index) const {
+        std::vector<Field> ans(rowCount);
+        for (size_t i = 0; i < rowCount; ++i) {
+            ans[i] = values[i * columnCount + index];
         }
-        return *this;
+        return ans;
     }
 
-    Matrix inverted() const {
-        static_assert(N == M);
-        Matrix copy = *this;
-        copy.invert();
-        return copy;
+    bool operator==(const DynMatrix& other) const {
+        return rowCount == other.rowCount && columnCount == other.columnCount && values == other.values;
     }
 
-    Matrix& invert() {
-        static_assert(N == M);
-        Matrix ans;
-        for (size_t i = 0; i < N; ++i) {
-            ans[i][i] = Field(1);
+    bool operator!=(const DynMatrix& other) const {
+        return !(*this == other);
+    }
+};
+
+template <typename Field>
+DynMatrix<Field> operator*(const DynMatrix<Field>& first, const DynMatrix<Field>& second) {
+    if (first.columns() != second.rows()) {
+        throw std::invalid_argument("matrices of different sizes");
+    }
+    size_t size = first.rows();
+    if constexpr (!std::is_floating_point_v<Field>) {
+        if (size == first.columns() && size == second.columns() && size > StrassenThreshold<Field>::value) {
+            DynMatrix<Field> ans(size, size);
+            std::vector<Field> workspace(strassen_workspace_size<Field>(size));
+            strassen_multiply(first.data(), size, second.data(), size, ans.data(), size, size, workspace.data());
+            return ans;
         }
-        size_t str_ind = 0;
-        for (size_t i = 0; i < N; ++i) {
-            if (str_ind == M) {
-                break;
+    }
+    DynMatrix<Field> ans(first.rows(), second.columns());
+    multiply_add(first.data(), first.columns(), second.data(), second.columns(), ans.data(), ans.columns(),
+                 first.rows(), first.columns(), second.columns());
+    return ans;
+}
+
+template <typename Field>
+DynMatrix<Field>& DynMatrix<Field>::operator*=(const DynMatrix<Field>& other) {
+    return *this = (*this) * other;
+}
+
+template <typename Field>
+DynMatrix<Field> operator+(DynMatrix<Field> first, const DynMatrix<Field>& second) {
+    first += second;
+    return first;
+}
+
+template <typename Field>
+DynMatrix<Field> operator-(DynMatrix<Field> first, const DynMatrix<Field>& second) {
+    first -= second;
+    return first;
+}
+
+template <typename Field>
+DynMatrix<Field> operator*(DynMatrix<Field> matr, const Field& value) {
+    matr *= value;
+    return matr;
+}
+
+template <typename Field>
+DynMatrix<Field> operator*(const Field& value, DynMatrix<Field> matr) {
+    matr *= value;
+    return matr;
+}
+
+//PA = LU computed once: L is unit lower triangular and shares the storage with U, the row permutation is kept
+//as a vector; any M x N matrix can be factored for rank(), solve(), det() and inverse() need a square nonsingular one
+template <typename Field = Rational>
+class LU {
+private:
+    size_t rowCount = 0;
+    size_t columnCount = 0;
+    std::vector<Field> factors;
+    std::vector<size_t> permutation;
+    std::vector<size_t> pivotColumns;
+    bool negated = false;
+
+    void factorize() {
+        negated = lu_factorize(factors.data(), columnCount, rowCount, columnCount, permutation, pivotColumns);
+        std::vector<size_t> order = permutation;
+        permute_rows(factors.data(), columnCount, columnCount, order);
+    }
+
+    void checkInvertible() const {
+        if (rowCount != columnCount) {
+            throw std::invalid_argument("the matrix is not square");
+        }
+        if (pivotColumns.size() < rowCount) {
+            throw std::invalid_argument("the matrix is singular");
+        }
+    }
+
+    //solves in place for `width` right-hand sides stored as rows of a row-major block, already permuted
+    void substitute(Field* values, size_t width) const {
+        size_t size = rowCount;
+        for (size_t i = 1; i < size; ++i) {
+            for (size_t k = 0; k < i; ++k) {
+                const Field& coeff = factors[i * size + k];
+                if (!FieldTraits<Field>::is_zero(coeff)) {
+                    subtractMultiple(values + i * width, values + k * width, coeff, width);
+                }
             }
-            size_t ind_whithout_zero = M;
-            for (size_t j = str_ind; j < M; ++j) {
-                if (arr[j][i] != Field(0)) {
-                    ind_whithout_zero = j;
-                    break;
+        }
+        for (size_t i = size; i > 0; --i) {
+            Field* row = values + (i - 1) * width;
+            for (size_t k = i; k < size; ++k) {
+                const Field& coeff = factors[(i - 1) * size + k];
+                if (!FieldTraits<Field>::is_zero(coeff)) {
+                    subtractMultiple(row, values + k * width, coeff, width);
                 }
             }
-            if (ind_whithout_zero == M) {
+            const Field& pivot = factors[(i - 1) * size + i - 1];
+            if (FieldTraits<Field>::is_one(pivot)) {
                 continue;
             }
-            if (ind_whithout_zero != str_ind) {
-                for (size_t q = 0; q < N; ++q) {
-                    arr[str_ind][q] += arr[ind_whithout_zero][q];
-                    ans.arr[str_ind][q] += ans.arr[ind_whithout_zero][q];
-                }
-            }
-            for (size_t j = 0; j < M; ++j) {
-                if (j == str_ind) {
-                    continue;
-                }
-                if (arr[j][i] == Field(0)) {
-                    continue;
-                }
-                Field k = arr[j][i] / arr[str_ind][i];
-                for (size_t q = 0; q < N; ++q) {
-                    arr[j][q] -= arr[str_ind][q] * k;
-                    ans.arr[j][q] -= ans.arr[str_ind][q] * k;
-                }
+            Field inverse = Field(1) / pivot;
+            for (size_t q = 0; q < width; ++q) {
+                row[q] *= inverse;
             }
-            ++str_ind;
         }
+    }
+public:
+    template <size_t M, size_t N>
+    explicit LU(const Matrix<M, N, Field>& matrix) : rowCount(M), columnCount(N), factors(M * N) {
         for (size_t i = 0; i < M; ++i) {
-            for (size_t q = 0; q < N; ++q) {
-                ans.arr[i][q] /= arr[i][i];
-            }
+            std::copy(matrix[i].begin(), matrix[i].end(), factors.begin() + i * N);
         }
-        return *this = ans;
+        factorize();
     }
 
-    Matrix<N, M, Field> transposed() const {
-        Matrix<N, M, Field> ans;
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                ans[j][i] = arr[i][j];
-            }
-        }
-        return ans;
+    explicit LU(const DynMatrix<Field>& matrix) : rowCount(matrix.rows()), columnCount(matrix.columns()),
+        factors(matrix.data(), matrix.data() + matrix.rows() * matrix.columns()) {
+        factorize();
+    }
+
+    size_t rank() const {
+        return pivotColumns.size();
     }
 
     Field det() const {
-        static_assert(N == M);
-        Matrix triangle_matr = *this;
-        triangle_matr.Gauss_method();
+        if (rowCount != columnCount) {
+            throw std::invalid_argument("the matrix is not square");
+        }
+        if (pivotColumns.size() < rowCount) {
+            return Field(0);
+        }
         Field ans = Field(1);
-        for (size_t i = 0; i < N; ++i) {
-            ans *= triangle_matr.arr[i][i];
+        for (size_t i = 0; i < rowCount; ++i) {
+            ans *= factors[i * columnCount + i];
+        }
+        if (negated) {
+            FieldTraits<Field>::negate_inplace(ans);
         }
         return ans;
     }
 
-    Field trace() const {
-        static_assert(N == M);
-        Field ans = Field(0);
-        for (size_t i = 0; i < N; ++i) {
-            ans += arr[i][i];
-        }
+    //the row permutation: row i of PA is row permutation()[i] of A
+    const std::vector<size_t>& rowPermutation() const {
+        return permutation;
+    }
+
+    //L below the diagonal and U on and above it
+    DynMatrix<Field> packedFactors() const {
+        DynMatrix<Field> ans(rowCount, columnCount);
+        std::copy(factors.begin(), factors.end(), ans.data());
         return ans;
     }
 
-    size_t rank() const {
-        Matrix triangle_matr = *this;
-        triangle_matr.Gauss_method();
-        for (size_t i = 0; i < M; ++i) {
-            bool zero = true;
-            for (size_t j = 0; j < N; ++j) {
-                if (triangle_matr.arr[i][j] != Field(0)) {
-                    zero = false;
-                    break;
-                }
-            }
-            if (zero) {
-                return i;
-            }
+    std::vector<Field> solve(const std::vector<Field>& b) const {
+        checkInvertible();
+        if (b.size() != rowCount) {
+            throw std::invalid_argument("vectors of different sizes");
         }
-        return M;
+        std::vector<Field> ans(rowCount);
+        for (size_t i = 0; i < rowCount; ++i) {
+            ans[i] = b[permutation[i]];
+        }
+        substitute(ans.data(), 1);
+        return ans;
     }
 
-    std::array<Field, N> getRow(size_t index) const {
-        return arr[index];
+    DynMatrix<Field> solve(const DynMatrix<Field>& b) const {
+        checkInvertible();
+        if (b.rows() != rowCount) {
+            throw std::invalid_argument("matrices of different sizes");
+        }
+        DynMatrix<Field> ans(rowCount, b.columns());
+        for (size_t i = 0; i < rowCount; ++i) {
+            std::copy(b[permutation[i]].begin(), b[permutation[i]].end(), ans[i].begin());
+        }
+        substitute(ans.data(), b.columns());
+        return ans;
     }
 
-    std::array<Field, M> getColumn(size_t index) const {
-        std::array<Field, M> ans;
+    template <size_t M, size_t K>
+    Matrix<M, K, Field> solve(const Matrix<M, K, Field>& b) const {
+        checkInvertible();
+        if (M != rowCount) {
+            throw std::invalid_argument("matrices of different sizes");
+        }
+        static_assert(sizeof(std::array<Field, K>) == K * sizeof(Field));
+        Matrix<M, K, Field> ans;
         for (size_t i = 0; i < M; ++i) {
-            ans[i] = arr[i][index];
+            ans[i] = b[permutation[i]];
         }
+        substitute(ans[0].data(), K);
         return ans;
     }
 
-    bool operator==(const Matrix& other) const {
-        for (size_t i = 0; i < M; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                if (arr[i][j] != other.arr[i][j]) {
-                    return false;
+    DynMatrix<Field> inverse() const {
+        checkInvertible();
+        return solve(DynMatrix<Field>::identity(rowCount));
+    }
+};
+
+//compressed sparse rows: the nonzeros of row i are values[rowStarts[i]..rowStarts[i + 1]), sorted by column,
+//in the columns columnIndices[rowStarts[i]..rowStarts[i + 1])
+template <typename Field = Rational>
+class SparseMatrix {
+private:
+    size_t rowCount = 0;
+    size_t columnCount = 0;
+    std::vector<size_t> rowStarts;
+    std::vector<size_t> columnIndices;
+    std::vector<Field> values;
+public:
+    SparseMatrix() : rowStarts(1, 0) {}
+
+    //(row, column, value) triples in any order, repeated positions are summed and zero sums dropped
+    SparseMatrix(size_t rows, size_t columns, std::vector<std::tuple<size_t, size_t, Field>> entries)
+        : rowCount(rows), columnCount(columns), rowStarts(rows + 1, 0) {
+        std::sort(entries.begin(), entries.end(), [](const auto& first, const auto& second) {
+            return std::tie(std::get<0>(first), std::get<1>(first)) < std::tie(std::get<0>(second), std::get<1>(second));
+        });
+        columnIndices.reserve(entries.size());
+        values.reserve(entries.size());
+        for (size_t k = 0; k < entries.size();) {
+            auto [row, column, value] = entries[k];
+            for (++k; k < entries.size() && std::get<0>(entries[k]) == row && std::get<1>(entries[k]) == column; ++k) {
+                value += std::get<2>(entries[k]);
+            }
+            if (!FieldTraits<Field>::is_zero(value)) {
+                columnIndices.push_back(column);
+                values.push_back(value);
+                ++rowStarts[row + 1];
+            }
+        }
+        std::partial_sum(rowStarts.begin(), rowStarts.end(), rowStarts.begin());
+    }
+
+    explicit SparseMatrix(const DynMatrix<Field>& matrix) : rowCount(matrix.rows()), columnCount(matrix.columns()),
+        rowStarts(1, 0) {
+        for (size_t i = 0; i < rowCount; ++i) {
+            for (size_t j = 0; j < columnCount; ++j) {
+                if (!FieldTraits<Field>::is_zero(matrix[i][j])) {
+                    columnIndices.push_back(j);
+                    values.push_back(matrix[i][j]);
                 }
             }
+            rowStarts.push_back(values.size());
         }
-        return true;
     }
 
-    bool operator!=(const Matrix& other) const {
-        return !(*this == other);
+    size_t rows() const {
+        return rowCount;
     }
 
-    template<size_t K>
-    Matrix<M, K, Field> operator*=(const Matrix<N, K, Field>& other);
-};
+    size_t columns() const {
+        return columnCount;
+    }
 
-template<size_t M, size_t N, typename Field>
-template<size_t K>
-Matrix<M, K, Field> Matrix<M, N, Field>::operator*=(const Matrix<N, K, Field>& other) {
-    return *this = (*this) * other;
-}
+    size_t nonZeros() const {
+        return values.size();
+    }
 
-template<size_t M, size_t N, size_t K, typename Field = Rational>
-Matrix<M, K, Field> operator*(const Matrix<M, N, Field>& first, const Matrix<N, K, Field>& second) {
-    Matrix<M, K, Field> ans;
-    for (size_t i = 0; i < M; ++i) {
-        for (size_t j = 0; j < K; ++j) {
-            for (size_t q = 0; q < N; ++q) {
-                ans[i][j] += first[i][q] * second[q][j];
+    Field at(size_t row, size_t column) const {
+        auto begin = columnIndices.begin() + rowStarts[row];
+        auto end = columnIndices.begin() + rowStarts[row + 1];
+        auto found = std::lower_bound(begin, end, column);
+        if (found == end || *found != column) {
+            return FieldTraits<Field>::zero;
+        }
+        return values[found - columnIndices.begin()];
+    }
+
+    //ans = *this * vector, rows split over the thread pool; ans must not overlap vector
+    void multiply(const Field* vector, Field* ans) const {
+        size_t cost = values.size() / std::max<size_t>(rowCount, 1) + 1;
+        parallel_for(rowCount, cost, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                size_t start = rowStarts[i];
+                ans[i] = gather_dot(values.data() + start, columnIndices.data() + start, vector,
+                                    rowStarts[i + 1] - start);
+            }
+        });
+    }
+
+    std::vector<Field> operator*(const std::vector<Field>& vector) const {
+        if (vector.size() != columnCount) {
+            throw std::invalid_argument("vectors of different sizes");
+        }
+        std::vector<Field> ans(rowCount);
+        multiply(vector.data(), ans.data());
+        return ans;
+    }
+
+    DynMatrix<Field> dense() const {
+        DynMatrix<Field> ans(rowCount, columnCount);
+        for (size_t i = 0; i < rowCount; ++i) {
+            for (size_t k = rowStarts[i]; k < rowStarts[i + 1]; ++k) {
+                ans[i][columnIndices[k]] = values[k];
+            }
+        }
+        return ans;
+    }
+
+    SparseMatrix transposed() const {
+        SparseMatrix ans;
+        ans.rowCount = columnCount;
+        ans.columnCount = rowCount;
+        ans.rowStarts.assign(columnCount + 1, 0);
+        ans.columnIndices.resize(values.size());
+        ans.values.resize(values.size());
+        for (size_t column : columnIndices) {
+            ++ans.rowStarts[column + 1];
+        }
+        std::partial_sum(ans.rowStarts.begin(), ans.rowStarts.end(), ans.rowStarts.begin());
+        std::vector<size_t> next(ans.rowStarts.begin(), ans.rowStarts.end() - 1);
+        for (size_t i = 0; i < rowCount; ++i) {
+            for (size_t k = rowStarts[i]; k < rowStarts[i + 1]; ++k) {
+                size_t position = next[columnIndices[k]]++;
+                ans.columnIndices[position] = i;
+                ans.values[position] = values[k];
             }
         }
+        return ans;
+    }
+};
+
+//the shortest recurrence s_i = c_1 s_(i-1) + ... + c_L s_(i-L) the sequence satisfies, returned as c_1, ..., c_L.
+//A sequence of 2L terms determines it
+template <typename Field>
+std::vector<Field> berlekamp_massey(const std::vector<Field>& sequence) {
+    //connection polynomials with constant term 1: current annuls the sequence so far, previous did before the last
+    //change of length
+    std::vector<Field> current(1, Field(1));
+    std::vector<Field> previous(1, Field(1));
+    Field previous_discrepancy = Field(1);
+    size_t length = 0;
+    size_t shift = 1;
+    //s_(i-1), ..., s_(i-L) lie forwards in the reversed sequence, so the discrepancy is one contiguous dot product
+    size_t size = sequence.size();
+    std::vector<Field> reversed(sequence.rbegin(), sequence.rend());
+    for (size_t i = 0; i < size; ++i, ++shift) {
+        Field discrepancy = sequence[i] + dot_product(current.data() + 1, reversed.data() + size - i, length);
+        if (FieldTraits<Field>::is_zero(discrepancy)) {
+            continue;
+        }
+        Field coeff = discrepancy / previous_discrepancy;
+        std::vector<Field> copy;
+        bool longer = 2 * length <= i;
+        if (longer) {
+            copy = current;
+        }
+        if (current.size() < previous.size() + shift) {
+            current.resize(previous.size() + shift, FieldTraits<Field>::zero);
+        }
+        subtractMultiple(current.data() + shift, previous.data(), coeff, previous.size());
+        if (longer) {
+            length = i + 1 - length;
+            previous = std::move(copy);
+            previous_discrepancy = discrepancy;
+            shift = 0;
+        }
+    }
+    current.resize(length + 1, FieldTraits<Field>::zero);
+    std::vector<Field> ans(current.begin() + 1, current.end());
+    for (Field& value : ans) {
+        FieldTraits<Field>::negate_inplace(value);
     }
     return ans;
 }
 
-template<size_t M, size_t N, typename Field = Rational>
-Matrix<M, N, Field> operator+(const Matrix<M, N, Field> first, const Matrix<M, N, Field> second) {
-    Matrix<M, N, Field> copy = first;
-    copy += second;
-    return copy;
+//random trials of the Wiedemann routines before they give up; each one fails with probability about size / N
+inline constexpr size_t wiedemann_attempts = 4;
+
+//the preconditioners of det and rank need distinct random values among about size^2 pairs, which a field of
+//fewer than 2 size^2 elements cannot promise: such matrices are eliminated densely instead
+template <size_t N>
+bool wiedemann_small_field(size_t size) {
+    return size > 0 && N / 2 / size < size;
 }
 
-template<size_t M, size_t N, typename Field = Rational>
-Matrix<M, N, Field> operator-(const Matrix<M, N, Field> first, const Matrix<M, N, Field> second) {
-    Matrix<M, N, Field> copy = first;
-    copy -= second;
-    return copy;
+template <size_t N>
+Residue<N> random_residue(std::mt19937_64& generator, bool nonzero = false) {
+    if (nonzero) {
+        return Residue<N>(static_cast<long long>(1 + generator() % (N - 1)));
+    }
+    return Residue<N>(static_cast<long long>(generator() % N));
 }
 
-template<size_t M, size_t N, typename Field = Rational>
-Matrix<M, N, Field> operator*(const Matrix<M, N, Field>& matr, const Field& value) {
-    Matrix<M, N, Field> copy = matr;
-    copy *= value;
-    return copy;
+//u A^i v for i < length, with apply(in, out) computing out = A in
+template <size_t N, typename Apply>
+std::vector<Residue<N>> krylov_sequence(const Apply& apply, const std::vector<Residue<N>>& u,
+                                        std::vector<Residue<N>> v, size_t length) {
+    std::vector<Residue<N>> ans(length);
+    std::vector<Residue<N>> next(v.size());
+    for (size_t i = 0; i < length; ++i) {
+        ans[i] = dot(std::span<const Residue<N>>(u), std::span<const Residue<N>>(v));
+        if (i + 1 < length) {
+            apply(v.data(), next.data());
+            std::swap(v, next);
+        }
+    }
+    return ans;
 }
 
-template<size_t M, size_t N, typename Field = Rational>
-Matrix<M, N, Field> operator*(const Field& value, const Matrix<M, N, Field>& matr) {
-    Matrix<M, N, Field> copy = matr;
-    copy *= value;
-    return copy;
+//Wiedemann: f, the minimal polynomial of b under A read off u A^i b by Berlekamp-Massey, has f(A) b = 0, so with
+//f(x) = x g(x) + f(0) the solution is x = -g(A) b / f(0) and needs only products with A. f(0) = 0 means A is
+//singular, which is reported as in LU. O(n) products and O(n^2) field operations
+template <size_t N>
+std::vector<Residue<N>> wiedemann_solve(const SparseMatrix<Residue<N>>& matrix, const std::vector<Residue<N>>& b) {
+    static_assert(is_prime(N));
+    if (matrix.rows() != matrix.columns()) {
+        throw std::invalid_argument("the matrix is not square");
+    }
+    if (b.size() != matrix.rows()) {
+        throw std::invalid_argument("vectors of different sizes");
+    }
+    size_t size = matrix.rows();
+    auto apply = [&](const Residue<N>* in, Residue<N>* out) {
+        matrix.multiply(in, out);
+    };
+    std::mt19937_64 generator(std::random_device{}());
+    std::vector<Residue<N>> u(size);
+    std::vector<Residue<N>> ans(size);
+    std::vector<Residue<N>> next(size);
+    for (size_t attempt = 0; attempt < wiedemann_attempts; ++attempt) {
+        for (Residue<N>& value : u) {
+            value = random_residue<N>(generator);
+        }
+        //f(x) = x^L - c_1 x^(L-1) - ... - c_L
+        std::vector<Residue<N>> recurrence = berlekamp_massey(krylov_sequence<N>(apply, u, b, 2 * size));
+        size_t length = recurrence.size();
+        if (length > 0 && FieldTraits<Residue<N>>::is_zero(recurrence.back())) {
+            throw std::invalid_argument("the matrix is singular");
+        }
+        //Horner: ans = A^(L-1) b - c_1 A^(L-2) b - ... - c_(L-1) b, then A ans = c_L b
+        std::fill(ans.begin(), ans.end(), FieldTraits<Residue<N>>::zero);
+        if (length > 0) {
+            ans = b;
+            for (size_t j = 0; j + 1 < length; ++j) {
+                apply(ans.data(), next.data());
+                std::swap(ans, next);
+                subtractMultiple(ans.data(), b.data(), recurrence[j], size);
+            }
+            Residue<N> inverse = recurrence.back().inverse();
+            for (Residue<N>& value : ans) {
+                value *= inverse;
+            }
+        }
+        apply(ans.data(), next.data());
+        if (next == b) {
+            return ans;
+        }
+    }
+    throw std::invalid_argument("the matrix is singular");
 }
 
-template <size_t N, typename Field = Rational>
-using SquareMatrix = Matrix<N, N, Field>;
+//A D with a random nonsingular diagonal D has a squarefree characteristic polynomial with high probability
+//(Chen, Eberly, Kaltofen, Saunders, Turner, Villard), so its minimal polynomial has degree n and gives
+//det(A D) = (-1)^n f(0). f(0) = 0 proves A singular, a shorter f is retried and gives up after
+//wiedemann_attempts. Fields with N < 2 n^2 go through LU
+template <size_t N>
+Residue<N> wiedemann_det(const SparseMatrix<Residue<N>>& matrix) {
+    static_assert(is_prime(N));
+    if (matrix.rows() != matrix.columns()) {
+        throw std::invalid_argument("the matrix is not square");
+    }
+    size_t size = matrix.rows();
+    if (size == 0) {
+        return Residue<N>(1);
+    }
+    if (wiedemann_small_field<N>(size)) {
+        return LU<Residue<N>>(matrix.dense()).det();
+    }
+    std::mt19937_64 generator(std::random_device{}());
+    std::vector<Residue<N>> diagonal(size);
+    std::vector<Residue<N>> scaled(size);
+    std::vector<Residue<N>> u(size);
+    std::vector<Residue<N>> v(size);
+    auto apply = [&](const Residue<N>* in, Residue<N>* out) {
+        for (size_t i = 0; i < size; ++i) {
+            scaled[i] = diagonal[i] * in[i];
+        }
+        matrix.multiply(scaled.data(), out);
+    };
+    for (size_t attempt = 0; attempt < wiedemann_attempts; ++attempt) {
+        for (size_t i = 0; i < size; ++i) {
+            diagonal[i] = random_residue<N>(generator, true);
+            u[i] = random_residue<N>(generator);
+            v[i] = random_residue<N>(generator);
+        }
+        std::vector<Residue<N>> recurrence = berlekamp_massey(krylov_sequence<N>(apply, u, v, 2 * size));
+        if (!recurrence.empty() && FieldTraits<Residue<N>>::is_zero(recurrence.back())) {
+            return Residue<N>(0);
+        }
+        if (recurrence.size() == size) {
+            //f(0) = -c_n
+            Residue<N> ans = size % 2 == 0 ? -recurrence.back() : recurrence.back();
+            Residue<N> scale(1);
+            for (const Residue<N>& value : diagonal) {
+                scale *= value;
+            }
+            return ans / scale;
+        }
+    }
+    throw std::runtime_error("no attempt found the minimal polynomial");
+}
+
+//for any shape, B = D1 A^T D2 A D1 with random nonsingular diagonals has rank r = rank(A) and, with high
+//probability, a minimal polynomial x^e g(x) with g(0) != 0 of degree r (Chen, Eberly, Kaltofen, Saunders,
+//Turner, Villard). Projections only ever lose factors, so every estimate is a lower bound and the largest one
+//over wiedemann_attempts is returned, stopping early only at full rank. The bound needs N >= 2 max(m, n)^2,
+//smaller fields go through LU
+template <size_t N>
+size_t wiedemann_rank(const SparseMatrix<Residue<N>>& matrix) {
+    static_assert(is_prime(N));
+    size_t rows = matrix.rows();
+    size_t columns = matrix.columns();
+    if (wiedemann_small_field<N>(std::max(rows, columns))) {
+        return LU<Residue<N>>(matrix.dense()).rank();
+    }
+    SparseMatrix<Residue<N>> transposed = matrix.transposed();
+    std::mt19937_64 generator(std::random_device{}());
+    std::vector<Residue<N>> right(columns);
+    std::vector<Residue<N>> left(rows);
+    std::vector<Residue<N>> scaled(columns);
+    std::vector<Residue<N>> image(rows);
+    std::vector<Residue<N>> u(columns);
+    std::vector<Residue<N>> v(columns);
+    auto apply = [&](const Residue<N>* in, Residue<N>* out) {
+        for (size_t j = 0; j < columns; ++j) {
+            scaled[j] = right[j] * in[j];
+        }
+        matrix.multiply(scaled.data(), image.data());
+        for (size_t i = 0; i < rows; ++i) {
+            image[i] *= left[i];
+        }
+        transposed.multiply(image.data(), out);
+        for (size_t j = 0; j < columns; ++j) {
+            out[j] *= right[j];
+        }
+    };
+    size_t ans = 0;
+    for (size_t attempt = 0; attempt < wiedemann_attempts && ans < std::min(rows, columns); ++attempt) {
+        for (size_t j = 0; j < columns; ++j) {
+            right[j] = random_residue<N>(generator, true);
+            u[j] = random_residue<N>(generator);
+            v[j] = random_residue<N>(generator);
+        }
+        for (size_t i = 0; i < rows; ++i) {
+            left[i] = random_residue<N>(generator, true);
+        }
+        //deg g is the index of the last nonzero c_j
+        std::vector<Residue<N>> recurrence = berlekamp_massey(krylov_sequence<N>(apply, u, v, 2 * columns));
+        size_t degree = recurrence.size();
+        while (degree > 0 && FieldTraits<Residue<N>>::is_zero(recurrence[degree - 1])) {
+            --degree;
+        }
+        ans = std::max(ans, degree);
+    }
+    return ans;
+}
@@ -0,0 +1,421 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <initializer_list>
+#include <stdexcept>
+#include "Matrix.h"
+
+template <size_t N>
+constexpr uint64_t quadratic_non_residue() {
+    uint64_t ans = 2;
+    while (power_mod(ans, (N - 1) / 2, N) != N - 1) {
+        ++ans;
+    }
+    return ans;
+}
+
+//roots[k] is a primitive root of unity of order 2^k, the transforms work up to length 2^maxLog
+template <size_t N>
+struct NttRoots {
+    static constexpr size_t maxLog = is_prime(N) ? std::countr_zero(static_cast<uint64_t>(N - 1)) : 0;
+
+    using Table = std::array<Residue<N>, maxLog + 1>;
+
+    static constexpr Table makeTable(bool inverse) {
+        Table ans{};
+        if constexpr (maxLog > 0) {
+            Residue<N> root = pown(Residue<N>(quadratic_non_residue<N>()), (N - 1) >> maxLog);
+            ans[maxLog] = inverse ? root.inverse() : root;
+            for (size_t k = maxLog; k > 0; --k) {
+                ans[k - 1] = ans[k] * ans[k];
+            }
+        }
+        return ans;
+    }
+};
+
+template <size_t N>
+inline constexpr typename NttRoots<N>::Table ntt_roots = NttRoots<N>::makeTable(false);
+
+template <size_t N>
+inline constexpr typename NttRoots<N>::Table ntt_inverse_roots = NttRoots<N>::makeTable(true);
+
+//coefficients are stored from the constant term up, the leading one is never zero
+template <size_t N>
+class Polynomial {
+private:
+    using Value = Residue<N>;
+    using Kernels = ResidueKernels<N>;
+
+    static constexpr size_t naiveLimit = 32;
+
+    std::vector<Value> coeffs;
+
+    void trim() {
+        while (!coeffs.empty() && coeffs.back() == Value(0)) {
+            coeffs.pop_back();
+        }
+    }
+
+    static void fillTwiddles(std::vector<Value>& twiddles, size_t length, const Value& root) {
+        twiddles[0] = Value(1);
+        for (size_t j = 1; j < length; ++j) {
+            twiddles[j] = twiddles[j - 1] * root;
+        }
+    }
+
+    //decimation in frequency: natural order in, bit-reversed order out
+    static void transform(std::vector<Value>& values) {
+        size_t n = values.size();
+        std::vector<Value> twiddles(n / 2);
+        for (size_t length = n / 2, log = std::countr_zero(n); length > 0; length /= 2, --log) {
+            fillTwiddles(twiddles, length, ntt_roots<N>[log]);
+            for (size_t start = 0; start < n; start += 2 * length) {
+                Kernels::forwardButterfly(values.data() + start, values.data() + start + length, twiddles.data(), length);
+            }
+        }
+    }
+
+    //decimation in time: bit-reversed order in, natural order out
+    static void inverseTransform(std::vector<Value>& values) {
+        size_t n = values.size();
+        std::vector<Value> twiddles(n / 2);
+        for (size_t length = 1, log = 1; length < n; length *= 2, ++log) {
+            fillTwiddles(twiddles, length, ntt_inverse_roots<N>[log]);
+            for (size_t start = 0; start < n; start += 2 * length) {
+                Kernels::inverseButterfly(values.data() + start, values.data() + start + length, twiddles.data(), length);
+            }
+        }
+        Value scale = Value(static_cast<long long>(n)).inverse();
+        for (Value& value : values) {
+            value *= scale;
+        }
+    }
+
+    static std::vector<Value> multiply(const std::vector<Value>& first, const std::vector<Value>& second) {
+        if (first.empty() || second.empty()) {
+            return {};
+        }
+        size_t result_size = first.size() + second.size() - 1;
+        size_t length = std::bit_ceil(result_size);
+        if (std::min(first.size(), second.size()) <= naiveLimit || static_cast<size_t>(std::countr_zero(length)) > NttRoots<N>::maxLog) {
+            std::vector<Value> ans(result_size, Value(0));
+            for (size_t i = 0; i < first.size(); ++i) {
+                Kernels::axpy(ans.data() + i, first[i], second.data(), second.size());
+            }
+            return ans;
+        }
+        std::vector<Value> ans = first;
+        ans.resize(length, Value(0));
+        transform(ans);
+        if (&first == &second) {
+            Kernels::multiply(ans.data(), ans.data(), length);
+        }
+        else {
+            std::vector<Value> other = second;
+            other.resize(length, Value(0));
+            transform(other);
+            Kernels::multiply(ans.data(), other.data(), length);
+        }
+        inverseTransform(ans);
+        ans.resize(result_size);
+        return ans;
+    }
+
+    Polynomial reversedPrefix(size_t count) const {
+        std::vector<Value> ans(coeffs.rbegin(), coeffs.rbegin() + std::min(count, coeffs.size()));
+        return Polynomial(std::move(ans));
+    }
+
+    static void buildTree(std::vector<Polynomial>& tree, size_t node, size_t left, size_t right,
+                          std::span<const Value> points) {
+        if (right - left == 1) {
+            tree[node] = Polynomial{-points[left], Value(1)};
+            return;
+        }
+        size_t middle = (left + right) / 2;
+        buildTree(tree, 2 * node, left, middle, points);
+        buildTree(tree, 2 * node + 1, middle, right, points);
+        tree[node] = tree[2 * node] * tree[2 * node + 1];
+    }
+
+    void evaluateOnTree(const std::vector<Polynomial>& tree, size_t node, size_t left, size_t right,
+                        std::span<const Value> points, std::vector<Value>& ans) const {
+        Polynomial reduced = *this % tree[node];
+        if (right - left <= naiveLimit) {
+            for (size_t i = left; i < right; ++i) {
+                ans[i] = reduced(points[i]);
+            }
+            return;
+        }
+        size_t middle = (left + right) / 2;
+        reduced.evaluateOnTree(tree, 2 * node, left, middle, points, ans);
+        reduced.evaluateOnTree(tree, 2 * node + 1, middle, right, points, ans);
+    }
+
+    static Polynomial combineOnTree(const std::vector<Polynomial>& tree, size_t node, size_t left, size_t right,
+                                    const std::vector<Value>& weights) {
+        if (right - left == 1) {
+            return Polynomial(weights[left]);
+        }
+        size_t middle = (left + right) / 2;
+        Polynomial ans = combineOnTree(tree, 2 * node, left, middle, weights) * tree[2 * node + 1];
+        ans += combineOnTree(tree, 2 * node + 1, middle, right, weights) * tree[2 * node];
+        return ans;
+    }
+public:
+    Polynomial() = default;
+
+    explicit Polynomial(const Value& constant) : coeffs{constant} {
+        trim();
+    }
+
+    explicit Polynomial(std::vector<Value> coefficients) : coeffs(std::move(coefficients)) {
+        trim();
+    }
+
+    Polynomial(std::initializer_list<Value> coefficients) : coeffs(coefficients) {
+        trim();
+    }
+
+    //-1 for the zero polynomial
+    long long degree() const {
+        return static_cast<long long>(coeffs.size()) - 1;
+    }
+
+    size_t size() const {
+        return coeffs.size();
+    }
+
+    bool isZero() const {
+        return coeffs.empty();
+    }
+
+    Value operator[](size_t index) const {
+        return index < coeffs.size() ? coeffs[index] : Value(0);
+    }
+
+    const std::vector<Value>& coefficients() const {
+        return coeffs;
+    }
+
+    Value operator()(const Value& point) const {
+        Value ans(0);
+        for (size_t i = coeffs.size(); i > 0; --i) {
+            ans = ans * point + coeffs[i - 1];
+        }
+        return ans;
+    }
+
+    //the remainder modulo x^count
+    Polynomial truncated(size_t count) const {
+        return Polynomial(std::vector<Value>(coeffs.begin(), coeffs.begin() + std::min(count, coeffs.size())));
+    }
+
+    Polynomial derivative() const {
+        std::vector<Value> ans(coeffs.size() > 0 ? coeffs.size() - 1 : 0);
+        for (size_t i = 1; i < coeffs.size(); ++i) {
+            ans[i - 1] = coeffs[i] * Value(static_cast<long long>(i));
+        }
+        return Polynomial(std::move(ans));
+    }
+
+    //the first count coefficients of 1 / P by Newton iteration g = g * (2 - P * g)
+    Polynomial inverse(size_t count) const {
+        static_assert(is_prime(N));
+        if (coeffs.empty() || coeffs[0] == Value(0)) {
+            throw std::invalid_argument("the constant term is not invertible");
+        }
+        Polynomial ans(coeffs[0].inverse());
+        for (size_t length = 1; length < count;) {
+            length *= 2;
+            Polynomial correction = (truncated(length) * ans).truncated(length);
+            correction = -correction;
+            correction.coeffs.resize(std::max<size_t>(correction.coeffs.size(), 1), Value(0));
+            correction.coeffs[0] += Value(2);
+            correction.trim();
+            ans = (ans * correction).truncated(length);
+        }
+        return ans.truncated(count);
+    }
+
+    Polynomial operator-() const {
+        Polynomial copy = *this;
+        for (Value& value : copy.coeffs) {
+            value = -value;
+        }
+        return copy;
+    }
+
+    Polynomial& operator+=(const Polynomial& other) {
+        coeffs.resize(std::max(coeffs.size(), other.coeffs.size()), Value(0));
+        Kernels::add(coeffs.data(), other.coeffs.data(), other.coeffs.size());
+        trim();
+        return *this;
+    }
+
+    Polynomial& operator-=(const Polynomial& other) {
+        coeffs.resize(std::max(coeffs.size(), other.coeffs.size()), Value(0));
+        Kernels::subtract(coeffs.data(), other.coeffs.data(), other.coeffs.size());
+        trim();
+        return *this;
+    }
+
+    Polynomial& operator*=(const Polynomial& other) {
+        coeffs = multiply(coeffs, other.coeffs);
+        trim();
+        return *this;
+    }
+
+    Polynomial& operator*=(const Value& scalar) {
+        for (Value& value : coeffs) {
+            value *= scalar;
+        }
+        trim();
+        return *this;
+    }
+
+    //*this becomes the quotient
+    Polynomial& divmod(const Polynomial& other, Polynomial& remainder) {
+        static_assert(is_prime(N));
+        if (other.coeffs.empty()) {
+            throw std::invalid_argument("division by the zero polynomial");
+        }
+        if (coeffs.size() < other.coeffs.size()) {
+            remainder = *this;
+            coeffs.clear();
+            return *this;
+        }
+        size_t quotient_size = coeffs.size() - other.coeffs.size() + 1;
+        Polynomial quotient;
+        Polynomial rest;
+        if (std::min(quotient_size, other.coeffs.size()) <= naiveLimit) {
+            Value lead_inverse = other.coeffs.back().inverse();
+            quotient.coeffs.resize(quotient_size);
+            rest = *this;
+            for (size_t i = quotient_size; i > 0; --i) {
+                Value coeff = rest.coeffs[i - 1 + other.coeffs.size() - 1] * lead_inverse;
+                quotient.coeffs[i - 1] = coeff;
+                subtractMultiple(rest.coeffs.data() + i - 1, other.coeffs.data(), coeff, other.coeffs.size());
+            }
+            rest.coeffs.resize(other.coeffs.size() - 1);
+            rest.trim();
+        }
+        else {
+            quotient = (reversedPrefix(quotient_size) * other.reversedPrefix(quotient_size).inverse(quotient_size))
+                .truncated(quotient_size);
+            quotient.coeffs.resize(quotient_size, Value(0));
+            std::reverse(quotient.coeffs.begin(), quotient.coeffs.end());
+            quotient.trim();
+            rest = *this;
+            rest -= other * quotient;
+        }
+        coeffs.swap(quotient.coeffs);
+        remainder = std::move(rest);
+        return *this;
+    }
+
+    Polynomial& operator/=(const Polynomial& other) {
+        Polynomial remainder;
+        return divmod(other, remainder);
+    }
+
+    Polynomial& operator%=(const Polynomial& other) {
+        Polynomial quotient = *this;
+        quotient.divmod(other, *this);
+        return *this;
+    }
+
+    //values at all points through the subproduct tree, O(n log^2 n)
+    std::vector<Value> evaluate(std::span<const Value> points) const {
+        std::vector<Value> ans(points.size());
+        if (points.size() <= naiveLimit) {
+            for (size_t i = 0; i < points.size(); ++i) {
+                ans[i] = (*this)(points[i]);
+            }
+            return ans;
+        }
+        std::vector<Polynomial> tree(4 * points.size());
+        buildTree(tree, 1, 0, points.size(), points);
+        evaluateOnTree(tree, 1, 0, points.size(), points, ans);
+        return ans;
+    }
+
+    //the polynomial of degree below points.size() with the given values, the points must be distinct
+    static Polynomial interpolate(std::span<const Value> points, std::span<const Value> values) {
+        static_assert(is_prime(N));
+        if (points.size() != values.size()) {
+            throw std::invalid_argument("vectors of different sizes");
+        }
+        if (points.empty()) {
+            return Polynomial();
+        }
+        std::vector<Polynomial> tree(4 * points.size());
+        buildTree(tree, 1, 0, points.size(), points);
+        std::vector<Value> weights(points.size());
+        tree[1].derivative().evaluateOnTree(tree, 1, 0, points.size(), points, weights);
+        for (const Value& weight : weights) {
+            if (weight == Value(0)) {
+                throw std::invalid_argument("interpolation points must be distinct");
+            }
+        }
+        batchInvert(std::span<Value>(weights));
+        Kernels::multiply(weights.data(), values.data(), weights.size());
+        return combineOnTree(tree, 1, 0, points.size(), weights);
+    }
+
+    bool operator==(const Polynomial& other) const {
+        return coeffs == other.coeffs;
+    }
+
+    bool operator!=(const Polynomial& other) const {
+        return coeffs != other.coeffs;
+    }
+};
+
+template <size_t N>
+Polynomial<N> operator+(Polynomial<N> first, const Polynomial<N>& second) {
+    return first += second;
+}
+
+template <size_t N>
+Polynomial<N> operator-(Polynomial<N> first, const Polynomial<N>& second) {
+    return first -= second;
+}
+
+template <size_t N>
+Polynomial<N> operator*(Polynomial<N> first, const Polynomial<N>& second) {
+    return first *= second;
+}
+
+template <size_t N>
+Polynomial<N> operator*(Polynomial<N> first, const Residue<N>& second) {
+    return first *= second;
+}
+
+template <size_t N>
+Polynomial<N> operator*(const Residue<N>& first, Polynomial<N> second) {
+    return second *= first;
+}
+
+template <size_t N>
+Polynomial<N> operator/(Polynomial<N> first, const Polynomial<N>& second) {
+    return first /= second;
+}
+
+template <size_t N>
+Polynomial<N> operator%(Polynomial<N> first, const Polynomial<N>& second) {
+    return first %= second;
+}
+
+template <size_t N>
+std::ostream& operator<<(std::ostream& out, const Polynomial<N>& polynomial) {
+    for (size_t i = 0; i < polynomial.size(); ++i) {
+        out << polynomial[i] << (i + 1 < polynomial.size() ? " " : "");
+    }
+    return out;
+}